@@ -0,0 +1,118 @@
+#define _GNU_SOURCE  // syscall
+
+#include "counters.h"
+
+#include <string.h>  // memset
+
+const char *counter_names[COUNTERS_LEN] = {
+    [COUNTER_CYCLES] = "cycles",
+    [COUNTER_INSTRUCTIONS] = "instr",
+    [COUNTER_L1D_MISSES] = "L1d-miss",
+    [COUNTER_LLC_MISSES] = "LLC-miss",
+    [COUNTER_DTLB_MISSES] = "dTLB-miss",
+};
+
+#ifdef __linux__
+
+#include <linux/perf_event.h>  // perf_event_attr, PERF_...
+#include <sys/ioctl.h>         // ioctl
+#include <sys/syscall.h>       // SYS_perf_event_open
+#include <unistd.h>            // syscall, read, close
+
+/* one event for each counter (not a group: counters that the CPU or the
+   container doesn't provide are left out, and the others are scaled if the
+   kernel multiplexes them), -1 if not available */
+static int fds[COUNTERS_LEN] = { -1, -1, -1, -1, -1 };
+
+static unsigned long long cache_event(int cache, int op, int result) {
+    return cache | (op << 8) | (result << 16);
+}
+
+static int open_event(unsigned int type, unsigned long long config) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;  // allowed with perf_event_paranoid up to 2
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+/**
+ * Open the counters for the calling thread.
+ *
+ * @return number of counters available (0 if perf_event_open is not allowed,
+ *         as in many containers)
+ */
+int counters_open(void) {
+    fds[COUNTER_CYCLES] = open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+    fds[COUNTER_INSTRUCTIONS] = open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+    fds[COUNTER_L1D_MISSES] = open_event(PERF_TYPE_HW_CACHE, cache_event(PERF_COUNT_HW_CACHE_L1D,
+            PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS));
+    fds[COUNTER_LLC_MISSES] = open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+    fds[COUNTER_DTLB_MISSES] = open_event(PERF_TYPE_HW_CACHE, cache_event(PERF_COUNT_HW_CACHE_DTLB,
+            PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS));
+
+    int available = 0;
+    for (int i = 0; i < COUNTERS_LEN; i++)
+        available += (fds[i] >= 0);
+    return available;
+}
+
+void counters_start(void) {
+    for (int i = 0; i < COUNTERS_LEN; i++) {
+        if (fds[i] >= 0) {
+            ioctl(fds[i], PERF_EVENT_IOC_RESET, 0);
+            ioctl(fds[i], PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+}
+
+/**
+ * Stop the counters and read them.
+ *
+ * @param values counts since counters_start (scaled up if the counter was
+ *        multiplexed), -1 for counters not available
+ */
+void counters_stop(double values[COUNTERS_LEN]) {
+    for (int i = 0; i < COUNTERS_LEN; i++) {
+        if (fds[i] >= 0)
+            ioctl(fds[i], PERF_EVENT_IOC_DISABLE, 0);
+    }
+    for (int i = 0; i < COUNTERS_LEN; i++) {
+        unsigned long long data[3];  // value, time enabled, time running
+        values[i] = -1.0;
+        if (fds[i] >= 0 && read(fds[i], data, sizeof(data)) == sizeof(data) && data[2] > 0)
+            values[i] = (double)data[0] * data[1] / data[2];
+    }
+}
+
+void counters_close(void) {
+    for (int i = 0; i < COUNTERS_LEN; i++) {
+        if (fds[i] >= 0)
+            close(fds[i]);
+        fds[i] = -1;
+    }
+}
+
+#else
+
+int counters_open(void) {
+    return 0;
+}
+
+void counters_start(void) {
+}
+
+void counters_stop(double values[COUNTERS_LEN]) {
+    for (int i = 0; i < COUNTERS_LEN; i++)
+        values[i] = -1.0;
+}
+
+void counters_close(void) {
+}
+
+#endif
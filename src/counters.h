@@ -0,0 +1,22 @@
+#ifndef __COUNTERS_H__
+#define __COUNTERS_H__
+
+/* hardware performance counters of the calling thread (perf_event_open on
+   Linux, user space only), counted between counters_start and counters_stop */
+enum {
+    COUNTER_CYCLES,
+    COUNTER_INSTRUCTIONS,
+    COUNTER_L1D_MISSES,
+    COUNTER_LLC_MISSES,
+    COUNTER_DTLB_MISSES,
+    COUNTERS_LEN
+};
+
+extern const char *counter_names[COUNTERS_LEN];
+
+int  counters_open(void);
+void counters_start(void);
+void counters_stop(double values[COUNTERS_LEN]);
+void counters_close(void);
+
+#endif /* __COUNTERS_H__ */
@@ -1,54 +1,372 @@
-#include "memlib.h"
+#define _GNU_SOURCE  // mremap, MAP_NORESERVE, MADV_HUGEPAGE
 
-#include <stdio.h>   // fprintf
-#include <stdlib.h>  // malloc, free, exit
-#include <errno.h>   // ENOMEM
+#include "memlib.h"
 
-#define MAX_HEAP (40*(1<<20))  /* 40 MB */
+#include <stdio.h>     // fprintf
+#include <stdlib.h>    // realloc, free, exit
+#include <string.h>    // memset
+#include <errno.h>     // ENOMEM
+#include <stdint.h>    // uintptr_t
+#include <sys/mman.h>  // mmap, mprotect, madvise, mremap, munmap
 
+/* the heap is a reserved range of mem_reserved_size bytes (at most
+   MEM_RESERVED), split into regions of one or more slots of MAX_HEAP bytes;
+   the last region is committed up to mem_commit */
 static char *mem_start_brk;
-static char *mem_brk;
+static size_t mem_reserved_size;
+static char *mem_region_start;  /* start of the last region */
+static char *mem_brk;           /* break of the last region */
+static char *mem_commit;
+static char *mem_resident;      /* pages above the break up to here may be resident */
 static char *mem_max_addr;
+static long mem_peak_size;
+static int mem_options;
+
+/* starts of the regions, breaks of the regions before the last one (which
+   don't move anymore), and the total size of those regions */
+static char *region_los[MEM_MAX_REGIONS];
+static char *region_brks[MEM_MAX_REGIONS];
+static int regions_len;
+static long full_regions_size;
+
+/* region of each slot (up to the end of the last region) */
+static short slot_regions[MEM_MAX_REGIONS];
+static int slots_len;
+
+/* the reservation is aligned to huge pages, committed by chunks */
+#define HUGE_PAGE_SIZE (2 * 1024 * 1024)
+#define COMMIT_CHUNK (64 * 1024)
+
+/* this much of the memory given back stays resident (zeroed), so that a heap
+   oscillating around the same size doesn't fault its pages in again and again */
+#define RETAIN_SIZE (4 * 1024 * 1024)
+
+/* the pages above that are given back once this much of them is resident, in
+   one batch (a heap trimmed and grown again by small steps doesn't pay for a
+   madvise and new faults at each step) */
+#define RELEASE_SIZE (4 * RETAIN_SIZE)
+
+/* mappings created by mem_map (outside of the heap) */
+typedef struct {
+    char *addr;
+    size_t size;
+} Mapping;
+
+static Mapping *mappings;
+static int mappings_len;
+static int mappings_cap;
+static long mapped_bytes;
+
+static void update_peak(void) {
+    if (mem_heapsize() > mem_peak_size)
+        mem_peak_size = mem_heapsize();
+}
+
+static void unmap_all(void) {
+    for (int i = 0; i < mappings_len; i++)
+        munmap(mappings[i].addr, mappings[i].size);
+    mappings_len = 0;
+    mapped_bytes = 0;
+}
+
+/**
+ * Make a region of `slots` slots, after the used ones, the last one (with an
+ * empty break).
+ */
+static void start_region(int slots) {
+    char *start = mem_start_brk + (size_t)slots_len * MAX_HEAP;
+    for (int i = 0; i < slots; i++)
+        slot_regions[slots_len++] = regions_len;
+    region_los[regions_len++] = start;
+    mem_region_start = start;
+    mem_max_addr = start + (size_t)slots * MAX_HEAP;
+    mem_brk = start;
+    mem_commit = start;  // pages committed before (if any) are committed again
+    mem_resident = start;
+}
+
+void mem_set_options(int options) {
+    mem_options = options;
+}
 
 void mem_init(void) {
-    mem_start_brk = malloc(MAX_HEAP);
-    if (mem_start_brk == NULL) {
-        fprintf(stderr, "Cannot allocate heap region\n");
+    // reserve address space only: pages are committed as the break advances
+    // (MEM_MAX_REGIONS slots, or 3/4 of the most that the address space has
+    // room for, as in 32-bit builds: the rest is left for mappings, stacks...)
+    size_t reserved = MEM_RESERVED;
+    char *addr = mmap(NULL, reserved + HUGE_PAGE_SIZE, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    while (addr == MAP_FAILED && reserved > MAX_HEAP) {
+        reserved -= MAX_HEAP;
+        addr = mmap(NULL, reserved + HUGE_PAGE_SIZE, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    }
+    if (addr == MAP_FAILED) {
+        fprintf(stderr, "Cannot reserve heap region\n");
         exit(1);
     }
+    size_t size = reserved + HUGE_PAGE_SIZE;
+    if (reserved < MEM_RESERVED && reserved > MAX_HEAP)
+        reserved = (reserved / MAX_HEAP * 3 + 3) / 4 * MAX_HEAP;
 
-    mem_max_addr = mem_start_brk + MAX_HEAP;
-    mem_brk = mem_start_brk;
+    // keep the reserved bytes starting at a huge page boundary
+    char *start = (char *)(((uintptr_t)addr + HUGE_PAGE_SIZE - 1) & ~(uintptr_t)(HUGE_PAGE_SIZE - 1));
+    if (start > addr)
+        munmap(addr, start - addr);
+    munmap(start + reserved, addr + size - (start + reserved));
+
+    if (mem_options & MEM_HUGE_PAGES)
+        madvise(start, reserved, MADV_HUGEPAGE);
+
+    mem_start_brk = start;
+    mem_reserved_size = reserved;
+    regions_len = 0;
+    slots_len = 0;
+    start_region(1);
+    full_regions_size = 0;
+    mem_peak_size = 0;
 }
 
 void mem_deinit(void) {
-    free(mem_start_brk);
+    unmap_all();
+    free(mappings);
+    mappings = NULL;
+    mappings_cap = 0;
+    munmap(mem_start_brk, mem_reserved_size);
+}
+
+/**
+ * Size of the range reserved for the regions of the heap (at most
+ * MEM_RESERVED bytes, less if the address space is too small).
+ */
+size_t mem_reserved(void) {
+    return mem_reserved_size;
+}
+
+/**
+ * Fault in the pages of a committed range (without waiting for first touch).
+ */
+static void prefault(char *lo, char *hi) {
+#ifdef MADV_POPULATE_WRITE
+    if (madvise(lo, hi - lo, MADV_POPULATE_WRITE) == 0)
+        return;
+#endif
+    for (char *p = lo; p < hi; p += MEM_PAGE_SIZE)
+        *(volatile char *)p = 0;
+}
+
+/**
+ * Make the heap readable and writable up to `addr`, by chunks (of huge pages,
+ * if enabled).
+ *
+ * @return 0, or -1 if the range can't be committed
+ */
+static int commit_up_to(char *addr) {
+    if (addr <= mem_commit)
+        return 0;
+
+    size_t chunk = (mem_options & MEM_HUGE_PAGES) ? HUGE_PAGE_SIZE : COMMIT_CHUNK;
+    size_t offset = (addr - mem_region_start + chunk - 1) / chunk * chunk;
+    char *new_commit = (offset > (size_t)(mem_max_addr - mem_region_start)) ? mem_max_addr : mem_region_start + offset;
+    if (mprotect(mem_commit, new_commit - mem_commit, PROT_READ | PROT_WRITE) != 0)
+        return -1;
+    if (mem_options & MEM_PREFAULT)
+        prefault(mem_commit, new_commit);
+    mem_commit = new_commit;
+    return 0;
+}
+
+/**
+ * Zero the range [lo, hi) of the heap, above a new break at `lo`. The pages
+ * above the break (up to `resident`, as [hi, resident) was given back before
+ * but may still be resident) are given back to the OS when more than
+ * RELEASE_SIZE bytes of them are resident, except the first RETAIN_SIZE bytes
+ * (unless pre-faulting is enabled).
+ *
+ * @return end of the pages above the break that may still be resident
+ */
+static char *discard(char *lo, char *hi, char *resident) {
+    char *keep = (resident - lo > RELEASE_SIZE) ? lo + RETAIN_SIZE : resident;
+    char *page = (char *)(((uintptr_t)keep + MEM_PAGE_SIZE - 1) & ~(uintptr_t)(MEM_PAGE_SIZE - 1));
+    if ((mem_options & MEM_PREFAULT) || page >= resident) {
+        memset(lo, 0, hi - lo);
+        return resident;
+    }
+    memset(lo, 0, ((page < hi) ? page : hi) - lo);
+    madvise(page, resident - page, MADV_DONTNEED);  // zero on next touch
+    return page;
 }
 
 void mem_reset_brk() {
-    mem_brk = mem_start_brk;
+    for (int i = 0; i < regions_len - 1; i++)
+        discard(mem_region_lo(i), region_brks[i], region_brks[i]);
+    discard(mem_region_start, mem_brk, mem_resident);
+    regions_len = 0;
+    slots_len = 0;
+    start_region(1);
+    full_regions_size = 0;
+    unmap_all();  // mappings still in use are lost too
+    mem_peak_size = 0;
 }
 
-char *mem_sbrk(int incr) {
+char *mem_sbrk(intptr_t incr) {
     char *old_brk = mem_brk;
-    if (incr < 0 || (mem_brk + incr) > mem_max_addr) {
+    if ((mem_brk + incr) < mem_region_start || (mem_brk + incr) > mem_max_addr ||
+            commit_up_to(mem_brk + incr) != 0) {
         errno = ENOMEM;
         fprintf(stderr, "ERROR: mem_sbrk failed. Ran out of memory...\n");
         return (void *)-1;
     }
 
+    if (incr < 0)
+        mem_resident = discard(mem_brk + incr, mem_brk, mem_resident);  // memory given back is zeroed
     mem_brk += incr;
+    if (mem_brk > mem_resident)
+        mem_resident = mem_brk;
+    update_peak();
     return old_brk;
 }
 
+/**
+ * Bytes that the break of the last region can still grow (then, the heap must
+ * continue on a new region).
+ */
+size_t mem_room(void) {
+    return mem_max_addr - mem_brk;
+}
+
+/**
+ * Start a new region of the heap, after the last one (whose break can't move
+ * anymore): then, mem_sbrk moves the break of the new region. The region is
+ * MAX_HEAP bytes, or as many slots of MAX_HEAP bytes as needed for `size`.
+ *
+ * @param size bytes that the break of the new region must be able to grow
+ * @return address of the new region (its break), or -1 if there are not
+ *         enough slots left in the reservation
+ */
+char *mem_new_region(size_t size) {
+    size_t slots = (size + MAX_HEAP - 1) / MAX_HEAP;
+    if (slots == 0)
+        slots = 1;
+    if (slots > mem_reserved_size / MAX_HEAP - slots_len) {
+        errno = ENOMEM;
+        fprintf(stderr, "ERROR: mem_new_region failed. Ran out of memory...\n");
+        return (void *)-1;
+    }
+    region_brks[regions_len - 1] = mem_brk;
+    full_regions_size += mem_brk - mem_region_start;
+    start_region(slots);
+    return mem_brk;
+}
+
+/**
+ * Reserve a zero-filled table of `size` bytes outside of the heap (e.g., for
+ * metadata about each address of the heap): pages are only faulted in when
+ * first touched, and are not counted by mem_heapsize. The table is never
+ * given back.
+ *
+ * @return address of the table, or `NULL` if it can't be reserved
+ */
+char *mem_table(size_t size) {
+    char *addr = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    return (addr == MAP_FAILED) ? NULL : addr;
+}
+
+char *mem_map(size_t size) {
+    if (mappings_len == mappings_cap) {
+        int cap = (mappings_cap == 0) ? 16 : 2 * mappings_cap;
+        Mapping *grown = realloc(mappings, cap * sizeof(Mapping));
+        if (grown == NULL)
+            return (void *)-1;
+        mappings = grown;
+        mappings_cap = cap;
+    }
+
+    // like fresh pages from the OS, mappings are zero
+    char *addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (addr == MAP_FAILED) {
+        errno = ENOMEM;
+        return (void *)-1;
+    }
+    mappings[mappings_len++] = (Mapping){ addr, size };
+    mapped_bytes += size;
+    update_peak();
+    return addr;
+}
+
+static int find_mapping(char *addr) {
+    for (int i = 0; i < mappings_len; i++) {
+        if (mappings[i].addr == addr)
+            return i;
+    }
+    return -1;
+}
+
+char *mem_remap(char *addr, size_t new_size) {
+    int i = find_mapping(addr);
+    if (i < 0)
+        return (void *)-1;
+
+    char *new_addr = mremap(addr, mappings[i].size, new_size, MREMAP_MAYMOVE);
+    if (new_addr == MAP_FAILED) {
+        errno = ENOMEM;
+        return (void *)-1;
+    }
+    mapped_bytes += (long)new_size - (long)mappings[i].size;
+    mappings[i] = (Mapping){ new_addr, new_size };
+    update_peak();
+    return new_addr;
+}
+
+void mem_unmap(char *addr) {
+    int i = find_mapping(addr);
+    if (i < 0)
+        return;
+
+    munmap(addr, mappings[i].size);
+    mapped_bytes -= mappings[i].size;
+    mappings[i] = mappings[--mappings_len];
+}
+
+int mem_mapped(char *lo, char *hi) {
+    for (int i = 0; i < mappings_len; i++) {
+        if (lo >= mappings[i].addr && hi < mappings[i].addr + mappings[i].size)
+            return 1;
+    }
+    return 0;
+}
+
+int mem_regions() {
+    return regions_len;
+}
+
+char *mem_region_lo(int i) {
+    return region_los[i];  // first byte of region i
+}
+
+char *mem_region_hi(int i) {
+    return ((i == regions_len - 1) ? mem_brk : region_brks[i]) - 1;  // last byte of region i
+}
+
+int mem_in_heap(char *lo, char *hi) {
+    if (lo < mem_start_brk || hi >= mem_brk)
+        return 0;
+    int i = slot_regions[(lo - mem_start_brk) / MAX_HEAP];
+    return hi <= mem_region_hi(i);
+}
+
 char *mem_heap_lo() {
-    return mem_start_brk;  // first heap byte
+    return mem_start_brk;  // first heap byte (of the first region)
 }
 
 char *mem_heap_hi() {
-    return mem_brk - 1;  // last heap byte
+    return mem_brk - 1;  // last heap byte (of the last region)
 }
 
 long mem_heapsize() {
-    return mem_brk - mem_start_brk;
+    // all regions, including mappings
+    return full_regions_size + (mem_brk - mem_region_start) + mapped_bytes;
+}
+
+long mem_peak_heapsize() {
+    return mem_peak_size;  // largest heap size since reset
 }
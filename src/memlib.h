@@ -1,12 +1,48 @@
 #ifndef __MEMLIB_H__
 #define __MEMLIB_H__
 
+#include <stddef.h>  // size_t
+#include <stdint.h>  // intptr_t
+
+#define MAX_HEAP (40*(1<<20))  /* 40 MB, for each region */
+#define MEM_PAGE_SIZE 4096     /* mappings are multiples of this size */
+
+/* the heap is made of regions, at consecutive slots of MAX_HEAP bytes in one
+   reservation of up to MEM_RESERVED bytes (only the last region grows, and a
+   region takes more than one slot for blocks larger than MAX_HEAP) */
+#ifndef MEM_MAX_REGIONS
+#if UINTPTR_MAX > 0xffffffffu
+#define MEM_MAX_REGIONS 256    /* 10 GB */
+#else
+#define MEM_MAX_REGIONS 96     /* 3.75 GB, or what the address space allows */
+#endif
+#endif
+#define MEM_RESERVED ((size_t)MEM_MAX_REGIONS * MAX_HEAP)
+
+/* options of the heap, for mem_set_options (before mem_init) */
+#define MEM_HUGE_PAGES 1  /* ask for transparent huge pages (MADV_HUGEPAGE) */
+#define MEM_PREFAULT   2  /* fault in pages when committed, keep them on trim */
+
+void  mem_set_options(int options);
 void  mem_init(void);
 void  mem_deinit(void);
-char *mem_sbrk(int incr);
+size_t mem_reserved(void);
+char *mem_sbrk(intptr_t incr);
+size_t mem_room(void);
+char *mem_new_region(size_t size);
+int   mem_regions(void);
+char *mem_region_lo(int i);
+char *mem_region_hi(int i);
+int   mem_in_heap(char *lo, char *hi);
+char *mem_table(size_t size);
 void  mem_reset_brk(void);
+char *mem_map(size_t size);
+char *mem_remap(char *addr, size_t new_size);
+void  mem_unmap(char *addr);
+int   mem_mapped(char *lo, char *hi);
 char *mem_heap_lo(void);
 char *mem_heap_hi(void);
 long  mem_heapsize(void);
+long  mem_peak_heapsize(void);
 
 #endif /* __MEMLIB_H__ */
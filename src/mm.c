@@ -1,33 +1,111 @@
 #include "mm.h"        // prototypes of functions implemented in this file
 #include "mm_list.h"   // "mm_list_..."  functions -- to manage explicit free list
+#include "mm_bitmap.h" // mm_bitmap_find -- to find non-empty size classes
+#include "mm_tree.h"   // mm_tree_best_fit -- to find large free blocks
 #include "mm_block.h"  // "mm_block_..." functions -- to manage blocks on the heap
-#include "memlib.h"    // mem_sbrk -- to extend the heap
+#include "mm_slab.h"   // "mm_slab_..." functions -- to manage runs of tiny objects
+#include "mm_round.h"  // "mm_round_..." functions -- to round up block sizes
+#include "mm_quick.h"  // "mm_quick_..." functions -- to cache freed blocks
+#include "mm_heapmap.h" // "mm_heapmap_..." functions -- to track allocated space
+#include "mm_tcache.h" // "mm_tcache_..." functions -- to cache objects per thread
+#include "memlib.h"    // mem_sbrk, mem_map -- to extend the heap, map huge blocks
+#include <stdio.h>     // printf -- to print the heap
 #include <string.h>    // memcpy -- to copy regions of memory
+#include <stdint.h>    // uintptr_t, SIZE_MAX -- to align addresses, check sizes
+#include <pthread.h>   // pthread_mutex_... -- to lock the heap
 
 #define MAX(x, y) ((x) > (y) ? (x) : (y))
 #define MIN(x, y) ((x) > (y) ? (y) : (x))
 
+// a free block at the end of the heap this large is given back by mem_sbrk
+#ifndef MM_TRIM_THRESHOLD
+#define MM_TRIM_THRESHOLD (128 * 1024)
+#endif
+
+// requests this large get a mapping of their own, outside of the heap
+#ifndef MM_MMAP_THRESHOLD
+#define MM_MMAP_THRESHOLD (128 * 1024)
+#endif
+
+// blocks of its own class checked by find_fit when no class is large enough
+// (so that the time to find a fit is bounded, as with TLSF)
+#ifndef MM_FIT_SCAN_MAX
+#define MM_FIT_SCAN_MAX 8
+#endif
+
+// blocks checked after a free block near the end of the heap, to find whether
+// only cached blocks keep it from being trimmed
+#ifndef MM_TRIM_SCAN_MAX
+#define MM_TRIM_SCAN_MAX 64
+#endif
+
+// held while using the heap (not needed for the cache of the thread)
+static pthread_mutex_t heap_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// objects from here to the break are not cached when freed, so that the free
+// space at the end of the heap can be trimmed (NULL while the heap is smaller
+// than 4 * MM_TRIM_THRESHOLD); written holding heap_lock, read without it
+static char *top_band;
+
+/**
+ * Mark the space of a block as allocated (or free) on the heap map, if it is
+ * enabled (by defining MM_HEAP_MAP).
+ *
+ * @param bp address of the block
+ * @param size size of the block in bytes
+ * @param allocated either 0 or 1
+ */
+static void heap_map(BlockHeader *bp, size_t size, int allocated) {
+#ifdef MM_HEAP_MAP
+    if (allocated)
+        mm_heapmap_set(bp, size);
+    else
+        mm_heapmap_clear(bp, size);
+#else
+    (void)bp;
+    (void)size;
+    (void)allocated;
+#endif
+}
+
+/**
+ * Clear the words that become payload when a free block `bp` is merged with
+ * the free block before it: the footer of the previous block, the header and
+ * the links of `bp` (its footer is still the footer of the merged block).
+ *
+ * @param bp address of a free block
+ */
+static void clear_junction(BlockHeader *bp) {
+    size_t size = mm_block_size(bp);
+    memset((char *)bp - 4, 0, 8 + MIN(MM_BLOCK_LINKS, size - 8));
+}
+
 /**
  * Mark a block as free, coalesce with contiguous free blocks on the heap, add
  * the coalesced block to the free list.
  *
+ * The coalesced block is zeroed only if all the merged blocks were zeroed.
+ *
  * @param bp address of the block to mark as free
  * @return the address of the coalesced block
  */
 static BlockHeader *free_coalesce(BlockHeader *bp) {
 
-    // mark block as free
-    int size = mm_block_size(bp);
+    // mark block as free (also in the header of the next block)
+    size_t size = mm_block_size(bp);
+    int zeroed = mm_block_zeroed(bp);
+    heap_map(bp, size, 0);
     mm_block_set_header(bp, size, 0);
     mm_block_set_footer(bp, size, 0);
+    mm_block_set_prev_allocated(mm_block_next(bp), 0);
 
     // check whether contiguous blocks are allocated
-    
-    int prev_alloc = mm_block_allocated(mm_block_prev(bp));
+    int prev_alloc = mm_block_prev_allocated(bp);
     int next_alloc = mm_block_allocated(mm_block_next(bp));
 
     if (prev_alloc && next_alloc) {
         // TODO: add bp to free list
+        mm_block_set_zeroed(bp, zeroed);
         mm_list_append(bp);
         return bp;
 
@@ -38,8 +116,12 @@ static BlockHeader *free_coalesce(BlockHeader *bp) {
         BlockHeader *next_block = mm_block_next(bp);
         mm_list_remove(next_block);
         size += mm_block_size(next_block);
+        zeroed = zeroed && mm_block_zeroed(next_block);
+        if (zeroed)
+            clear_junction(next_block);
         mm_block_set_header(bp,size,0);
         mm_block_set_footer(bp,size,0);
+        mm_block_set_zeroed(bp, zeroed);
         mm_list_prepend(bp);
         return bp;
 
@@ -47,9 +129,13 @@ static BlockHeader *free_coalesce(BlockHeader *bp) {
         // TODO: coalesce with previous block
         BlockHeader *prev_block = mm_block_prev(bp);
         mm_list_remove(prev_block);
+        zeroed = zeroed && mm_block_zeroed(prev_block);
+        if (zeroed)
+            clear_junction(bp);
         size += mm_block_size(prev_block);
         mm_block_set_header(prev_block,size,0);
         mm_block_set_footer(prev_block,size,0);
+        mm_block_set_zeroed(prev_block, zeroed);
         mm_list_append(prev_block);
         return prev_block;
 
@@ -61,20 +147,110 @@ static BlockHeader *free_coalesce(BlockHeader *bp) {
         mm_list_remove(prev_block);
         mm_list_remove(next_block);
         size += mm_block_size(prev_block) + mm_block_size(next_block);
+        zeroed = zeroed && mm_block_zeroed(prev_block) && mm_block_zeroed(next_block);
+        if (zeroed) {
+            clear_junction(next_block);
+            clear_junction(bp);
+        }
         mm_block_set_header(prev_block,size,0);
         mm_block_set_footer(prev_block,size,0);
+        mm_block_set_zeroed(prev_block, zeroed);
         mm_list_append(prev_block);
         return prev_block;
     }
 }
 
 /**
- * Allocate a free block of `size` byte (multiple of 8) on the heap.
+ * Find the prologue of a region of the heap (after some padding, so that
+ * payloads are aligned to MM_ALIGNMENT).
  *
- * @param size number of bytes to allocate (a multiple of 8)
+ * @param lo address of the first byte of the region
+ * @return pointer to the header of the prologue
+ */
+static BlockHeader *region_prologue(char *lo) {
+    size_t padding = -((uintptr_t)lo + 16) % MM_ALIGNMENT;
+    return (BlockHeader *)(lo + padding) + 1;
+}
+
+/**
+ * Start an empty heap of 4 x 4-byte words at the break: padding, prologue
+ * (header and footer), epilogue.
+ *
+ * @return pointer to the header of the prologue, or `NULL` if the heap is full
+ */
+static BlockHeader *init_region(void) {
+    char *lo = mem_sbrk(0);
+    BlockHeader *prologue = region_prologue(lo);
+    if ((long)mem_sbrk((char *)(prologue + 3) - lo) == -1)
+        return NULL;
+
+    mm_block_set_header(prologue - 1, 0, 0);  // skip 4 bytes for alignment
+    mm_block_set_header(prologue, 8, 1);      // allocate a block of 8 bytes as prologue
+    mm_block_set_prev_allocated(prologue, 1);
+    mm_block_set_footer(prologue, 8, 1);
+    mm_block_set_header(prologue + 2, 0, 1);  // epilogue (size 0, allocated)
+    mm_block_set_prev_allocated(prologue + 2, 1);
+    return prologue;
+}
+
+/**
+ * Check whether a block is the epilogue of the last region of the heap, after
+ * which the break can move.
+ *
+ * @param bp address of a block
+ * @return 1 if `bp` is the last block before the break, 0 otherwise
+ */
+static int at_break(BlockHeader *bp) {
+    return (char *)(bp + 1) == mem_heap_hi() + 1;
+}
+
+/**
+ * Move the band of the last 2 * MM_TRIM_THRESHOLD bytes of the heap after the
+ * break moved (when all of it is free, the block at the end of the heap is
+ * large enough to be trimmed, even if the blocks just below are cached).
+ */
+static void move_top_band(void) {
+    char *band = NULL;
+    if (mem_heapsize() >= 4 * MM_TRIM_THRESHOLD)
+        band = mem_heap_hi() + 1 - 2 * MM_TRIM_THRESHOLD;
+    __atomic_store_n(&top_band, band, __ATOMIC_RELAXED);
+}
+
+/**
+ * Check whether an object is in the band at the end of the heap, where freed
+ * objects are not cached (the band can move meanwhile, if the heap is not
+ * locked: then, the object is cached or not, as if freed a bit earlier).
+ *
+ * @param ptr address of an object
+ * @return 1 if the object is in the band, 0 otherwise
+ */
+static int in_top_band(void *ptr) {
+    char *band = __atomic_load_n(&top_band, __ATOMIC_RELAXED);
+    return band != NULL && (char *)ptr >= band;
+}
+
+/**
+ * Allocate a free block of `size` byte (multiple of MM_ALIGNMENT) on the heap.
+ *
+ * When the last region is full, the heap continues on a new region (larger
+ * than MAX_HEAP bytes, if needed for `size`): its prologue and epilogue keep
+ * blocks from crossing the gap between regions (marked as allocated on the
+ * heap map).
+ *
+ * @param size number of bytes to allocate (a multiple of MM_ALIGNMENT)
  * @return pointer to the header of the allocated block
  */
-static BlockHeader *extend_heap(int size) {
+static BlockHeader *extend_heap(size_t size) {
+
+    if (size > mem_room()) {
+        BlockHeader *old_epilogue = (BlockHeader *)(mem_heap_hi() + 1) - 1;
+        if (size > mem_reserved() || (long)mem_new_region(size + MM_ALIGNMENT + 16) == -1)
+            return NULL;
+        BlockHeader *prologue = init_region();
+        if (prologue == NULL)
+            return NULL;
+        heap_map(old_epilogue, (char *)(prologue + 2) - (char *)old_epilogue, 1);
+    }
 
     // bp points to the beginning of the new block
     char *bp = mem_sbrk(size);
@@ -85,59 +261,334 @@ static BlockHeader *extend_heap(int size) {
     BlockHeader *old_epilogue = (BlockHeader *)bp - 1;
     mm_block_set_header(old_epilogue, size, 0);
     mm_block_set_footer(old_epilogue, size, 0);
+    mm_block_set_zeroed(old_epilogue, 1);  // fresh memory from mem_sbrk
 
     // write new epilogue
-    mm_block_set_header(mm_block_next(old_epilogue), 0, 1);
+    BlockHeader *new_epilogue = mm_block_next(old_epilogue);
+    mm_block_set_header(new_epilogue, 0, 1);
+    mm_block_set_prev_allocated(new_epilogue, 0);
 
     // merge new block with previous one if possible
+    move_top_band();
     return free_coalesce(old_epilogue);
 }
 
+static void flush_caches(void);
+
+/**
+ * Check whether only cached blocks (allocated blocks, but not more than the
+ * cached bytes) keep a free block near the end of the heap from becoming a
+ * block that can be trimmed, looking at MM_TRIM_SCAN_MAX blocks at most.
+ *
+ * @param bp address of a free block
+ * @return 1 if flushing the caches would let the heap be trimmed
+ */
+static int cached_up_to_break(BlockHeader *bp) {
+    if (mm_block_size(bp) < MM_TRIM_THRESHOLD / 8 || mem_heapsize() < 2 * MM_TRIM_THRESHOLD ||
+            mem_heap_hi() + 1 - (char *)mm_block_next(bp) > 2 * MM_TRIM_THRESHOLD)
+        return 0;
+
+    size_t cached = mm_quick_bytes() + mm_tcache_bytes();
+    size_t allocated = 0;
+    size_t free = mm_block_size(bp);
+    bp = mm_block_next(bp);
+    for (int i = 0; i < MM_TRIM_SCAN_MAX && mm_block_size(bp) != 0; i++, bp = mm_block_next(bp)) {
+        if (mm_block_allocated(bp))
+            allocated += mm_block_size(bp);
+        else
+            free += mm_block_size(bp);
+        if (allocated > cached)
+            return 0;
+    }
+    return at_break(bp) && free >= MM_TRIM_THRESHOLD;
+}
+
+/**
+ * Give back to memlib the free block at the end of the heap, if it is larger
+ * than MM_TRIM_THRESHOLD, moving the epilogue down; then, free the cached
+ * blocks, so that those just below the new break can be trimmed too (also
+ * when only cached blocks are after the free block).
+ *
+ * @param bp address of a free (coalesced) block
+ */
+static void trim_heap(BlockHeader *bp) {
+    size_t size = mm_block_size(bp);
+    if (!at_break(mm_block_next(bp))) {
+        if (cached_up_to_break(bp))
+            flush_caches();
+        return;
+    }
+    if (size < MM_TRIM_THRESHOLD)
+        return;
+
+    mm_list_remove(bp);
+    if ((long)mem_sbrk(-(intptr_t)size) == -1) {
+        mm_list_prepend(bp);
+        return;
+    }
+
+    // the header of the block becomes the epilogue (previous block allocated)
+    mm_block_set_header(bp, 0, 1);
+    move_top_band();
+    flush_caches();
+}
+
+/**
+ * Compute the size of a mapping for a block with a payload of `payload_size`
+ * bytes aligned to `alignment` (the header is at most `alignment - 4` bytes
+ * after the start of the mapping).
+ *
+ * @param payload_size requested payload size
+ * @param alignment alignment of the payload (a power of 2, at least
+ *        MM_ALIGNMENT)
+ * @return size of the mapping (multiple of MEM_PAGE_SIZE), or 0 if too large
+ */
+static size_t mapping_size(size_t payload_size, size_t alignment) {
+    if (payload_size > SIZE_MAX - alignment - MEM_PAGE_SIZE)
+        return 0;
+    size_t size = alignment + payload_size;
+    return (size + MEM_PAGE_SIZE - 1) / MEM_PAGE_SIZE * MEM_PAGE_SIZE;
+}
+
+/**
+ * Write the header of a block in a mapping, with the payload `offset` bytes
+ * after the start of the mapping; the offset is kept in the word before the
+ * header, to find the start of the mapping again.
+ *
+ * @param start address of the mapping
+ * @param size size of the mapping
+ * @param offset offset of the payload (a multiple of MM_ALIGNMENT)
+ * @return pointer to the header of the block
+ */
+static BlockHeader *mapped_block(char *start, size_t size, size_t offset) {
+    BlockHeader *bp = (BlockHeader *)(start + offset - 4);
+    bp[-1] = offset;
+    mm_block_set_header(bp, size - (offset - MM_ALIGNMENT), 1);
+    mm_block_set_mapped(bp, 1);
+    return bp;
+}
+
+/**
+ * Find the start of the mapping of a block.
+ *
+ * @param bp pointer to the header of a mapped block
+ * @return address of the mapping
+ */
+static char *mapping_start(BlockHeader *bp) {
+    return (char *)bp + 4 - bp[-1];
+}
+
+/**
+ * Allocate a block in a mapping of its own, outside of the heap. For large
+ * alignments, the mapping is larger than the block: its start is only aligned
+ * to MEM_PAGE_SIZE.
+ *
+ * @param payload_size requested payload size
+ * @param alignment alignment of the payload (a power of 2, at least
+ *        MM_ALIGNMENT)
+ * @return pointer to the header of the block, or `NULL` if the mapping fails
+ */
+static BlockHeader *map_block(size_t payload_size, size_t alignment) {
+    size_t size = mapping_size(payload_size, alignment);
+    if (size == 0 || size > MM_BLOCK_MAX_SIZE)
+        return NULL;
+
+    char *start = mem_map(size);
+    if ((long)start == -1)
+        return NULL;
+    uintptr_t payload = ((uintptr_t)start + MM_ALIGNMENT + alignment - 1) & ~(uintptr_t)(alignment - 1);
+    return mapped_block(start, size, payload - (uintptr_t)start);
+}
+
 int mm_init(void) {
 
-    // init list of free blocks
+    // init list of free blocks and runs of tiny objects
     mm_list_init();
+    mm_slab_init();
+    mm_round_init();
+    mm_quick_init();
+    mm_tcache_init();
 
-    // create empty heap of 4 x 4-byte words
-    char *new_region = mem_sbrk(16);
-    if ((long)new_region == -1)
+    // create empty heap (heap_blocks points to the prologue header)
+    heap_blocks = init_region();
+    if (heap_blocks == NULL)
         return -1;
-
-    heap_blocks = (BlockHeader *)new_region;
-    mm_block_set_header(heap_blocks, 0, 0);      // skip 4 bytes for alignment
-    mm_block_set_header(heap_blocks + 1, 8, 1);  // allocate a block of 8 bytes as prologue
-    mm_block_set_footer(heap_blocks + 1, 8, 1);
-    mm_block_set_header(heap_blocks + 3, 0, 1);  // epilogue (size 0, allocated)
-    heap_blocks += 1;                            // point to the prologue header
+#ifdef MM_HEAP_MAP
+    mm_heapmap_init(heap_blocks);
+#endif
+    heap_map(heap_blocks, 8, 1);
 
     // TODO: extend heap with an initial heap size
     extend_heap(528);
     return 0;
 }
 
-void mm_free(void *bp) {
+/**
+ * Free all the blocks cached in the quick bins, coalescing them.
+ *
+ * @return 1 if some block was freed, 0 if the bins were empty
+ */
+static int flush_quick_bins(void) {
+    int flushed = 0;
+    BlockHeader *bp;
+    while ((bp = mm_quick_pop_any()) != NULL) {
+        trim_heap(free_coalesce(bp));
+        flushed = 1;
+    }
+    return flushed;
+}
+
+/**
+ * Free an allocated object (a block on the heap, a tiny object in a run or a
+ * huge block in a mapping).
+ *
+ * @param bp address of the payload
+ */
+static void release(void *bp) {
+    // objects back on the heap have no owner any more
+    if (mem_in_heap(bp, bp))
+        mm_tcache_clear_owner(bp);
+
+    // tiny objects go back to their run, which is freed when empty (kept if
+    // it's the last of its class, except at the end of the heap)
+    if (mm_slab_contains(bp)) {
+        bp = mm_slab_free(bp, !in_top_band(bp));
+        if (bp == NULL)
+            return;
+    }
+
     // TODO: move back 4 bytes to find the block header, then free block
     BlockHeader *find_head = (BlockHeader *)((char *)bp - 4);
+
+    // huge blocks are unmapped right away
+    if (mm_block_mapped(find_head)) {
+        mem_unmap(mapping_start(find_head));
+        return;
+    }
+    mm_round_freed(mm_block_size(find_head));
+
+    // small blocks are cached as they are, coalesced later in a batch
+    // (except at the end of the heap, where they would keep it from shrinking)
+    if (!in_top_band(find_head) && mm_quick_push(find_head)) {
+        if (mm_quick_bytes() > MM_QUICK_BUDGET)
+            flush_quick_bins();
+        return;
+    }
     find_head = free_coalesce(find_head);
+    trim_heap(find_head);
+}
+
+/**
+ * Free the objects cached by the calling thread and in the quick bins (and the
+ * empty runs kept for tiny objects), after the heap was trimmed: those just
+ * below the new break (marked as allocated) would keep it from moving down
+ * further.
+ */
+static void flush_caches(void) {
+    static int flushing;  // (releasing cached objects trims the heap again)
+    if (flushing)
+        return;
+    flushing = 1;
+    void *ptr;
+    while ((ptr = mm_tcache_pop_any()) != NULL)
+        release(ptr);
+    while ((ptr = mm_slab_pop_empty()) != NULL)
+        release(ptr);
+    flush_quick_bins();
+    flushing = 0;
+}
+
+static pthread_once_t thread_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t thread_key;
+
+/**
+ * Give back to the heap the objects cached by a thread (or freed for it by
+ * other threads) when it exits.
+ */
+static void thread_exit(void *arg) {
+    void *inbox = mm_tcache_exit();
+    pthread_mutex_lock(&heap_lock);
+    while (inbox != NULL) {
+        void *next = *(void **)inbox;
+        release(inbox);
+        inbox = next;
+    }
+    while ((arg = mm_tcache_pop_any()) != NULL)
+        release(arg);
+    pthread_mutex_unlock(&heap_lock);
+}
+
+static void create_thread_key(void) {
+    pthread_key_create(&thread_key, thread_exit);
+}
+
+/**
+ * Make sure that thread_exit is called when the calling thread exits.
+ */
+static void register_thread(void) {
+    static _Thread_local int registered;
+    if (!registered) {
+        pthread_once(&thread_key_once, create_thread_key);
+        pthread_setspecific(thread_key, &registered);
+        registered = 1;
+    }
+}
+
+/**
+ * Find the usable size of an allocated object, without holding the lock.
+ *
+ * The run bit of the page of a live object doesn't change until it is freed,
+ * nor does the size in its header; but other threads (holding the lock) can
+ * set the "previous allocated" bit of the header, so it is read with a single
+ * atomic load.
+ *
+ * @param ptr address of the payload
+ * @return number of bytes that can be used at `ptr`
+ */
+static size_t usable_size(void *ptr) {
+    if (mm_slab_contains(ptr))
+        return mm_slab_size(ptr);
+    BlockHeader header = __atomic_load_n((BlockHeader *)((char *)ptr - 4), __ATOMIC_RELAXED);
+    return mm_block_size(&header) - 4;
 }
 
 /**
  * Find a free block with size greater or equal to `size`.
  *
+ * Blocks of at least MM_TREE_MIN_SIZE bytes are found by best fit on the tree.
+ * For smaller sizes, the bitmap of non-empty size classes gives, in constant
+ * time, the smallest class whose blocks are all big enough; if there is none,
+ * the smallest block of the tree is used, and only if the tree is empty the
+ * first MM_FIT_SCAN_MAX blocks of the class of `size` are checked (first fit)
+ * before giving up.
+ *
  * @param size minimum size of the free block
  * @return pointer to the header of a free block or `NULL` if free blocks are
  *         all smaller than `size`.
  */
-static BlockHeader *find_fit(int size) {
-    // TODO: implement
-    BlockHeader *temp = mm_list_headp;
-    while (temp != NULL) {
+static BlockHeader *find_fit(size_t size) {
+    if (size >= MM_TREE_MIN_SIZE) {
+        return mm_tree_best_fit(size);
+    }
+
+    int cls = mm_bitmap_find(mm_list_fit_class(size));
+    if (cls >= 0) {
+        return mm_list_headp[cls];
+    }
+
+    BlockHeader *bp = mm_tree_best_fit(size);
+    if (bp != NULL) {
+        return bp;
+    }
+
+    cls = mm_list_class(size);
+    BlockHeader *temp = mm_list_headp[cls];
+    for (int i = 0; i < MM_FIT_SCAN_MAX && temp != NULL; i++, temp = mm_list_next(temp)) {
         if (mm_block_size(temp) >= size) {
             return temp;
         }
-        temp = mm_list_next(temp);
     }
-    
+
     return NULL;
 }
 
@@ -145,88 +596,471 @@ static BlockHeader *find_fit(int size) {
  * Allocate a block of `size` bytes inside the given free block `bp`.
  *
  * @param bp pointer to the header of a free block of at least `size` bytes
- * @param size bytes to assign as an allocated block (multiple of 8)
+ * @param size bytes to assign as an allocated block (multiple of MM_ALIGNMENT)
  * @return pointer to the header of the allocated block
  */
-static BlockHeader *place(BlockHeader *bp, int size) {
-    // TODO: if current size is greater, use part and add rest to free list
-    // TODO: return pointer to header of allocated block
-    int bs = mm_block_size(bp);
-    if (size < 96) {
-        if (bs - size < 16) {
-            mm_list_remove(bp);
-            mm_block_set_header(bp,bs,1);
-            mm_block_set_footer(bp,bs,1);
-            return bp;
-        }
-        else {
-            mm_list_remove(bp);
-            mm_block_set_header(bp,size,1);
-            mm_block_set_footer(bp,size,1);
-            BlockHeader* new_free = mm_block_next(bp);
-            mm_block_set_header(new_free,bs - size,0);
-            mm_block_set_footer(new_free,bs - size,0);
-            mm_list_prepend(new_free);
-            return bp;
-        }
+static BlockHeader *place(BlockHeader *bp, size_t size) {
+    size_t bs = mm_block_size(bp);
+    int zeroed = mm_block_zeroed(bp);
+    mm_list_remove(bp);
+
+    if (bs - size < 16) {
+        // leftover too small for a block, use all
+        mm_block_set_header(bp, bs, 1);
+        mm_block_set_prev_allocated(mm_block_next(bp), 1);
+        heap_map(bp, bs, 1);
+        return bp;
+    }
+    else if (size < 96) {
+        // small blocks at the beginning, rest is free
+        mm_block_set_header(bp, size, 1);
+        BlockHeader* new_free = mm_block_next(bp);
+        mm_block_set_header(new_free, bs - size, 0);
+        mm_block_set_prev_allocated(new_free, 1);
+        mm_block_set_footer(new_free, bs - size, 0);
+        mm_block_set_zeroed(new_free, zeroed);
+        mm_list_prepend(new_free);
+        heap_map(bp, size, 1);
+        return bp;
     }
     else {
-        if (bs - size < 16) {
-            mm_list_remove(bp);
-            mm_block_set_header(bp,bs,1);
-            mm_block_set_footer(bp,bs,1);
-            return bp;
-        }
-        else {
-            mm_list_remove(bp);
-            mm_block_set_header(bp,bs - size,0);
-            mm_block_set_footer(bp,bs - size,0);
-            BlockHeader* new_alloc = mm_block_next(bp);
-            mm_block_set_header(new_alloc,size,1);
-            mm_block_set_footer(new_alloc,size,1);
-            mm_list_prepend(bp);
-            return new_alloc;
-        }
+        // large blocks at the end, rest is free
+        mm_block_set_header(bp, bs - size, 0);
+        mm_block_set_footer(bp, bs - size, 0);
+        mm_block_set_zeroed(bp, zeroed);
+        BlockHeader* new_alloc = mm_block_next(bp);
+        mm_block_set_header(new_alloc, size, 1);
+        mm_block_set_prev_allocated(new_alloc, 0);
+        mm_block_set_prev_allocated(mm_block_next(new_alloc), 1);
+        mm_list_prepend(bp);
+        heap_map(new_alloc, size, 1);
+        return new_alloc;
     }
 }
 
 /**
- * Compute the required block size (including space for header/footer) from the
+ * Shrink an allocated block to `size` bytes, freeing the rest (and coalescing
+ * it with the next block) if it is big enough for a block.
+ *
+ * @param bp pointer to the header of an allocated block
+ * @param size bytes to keep in the allocated block (multiple of MM_ALIGNMENT)
+ */
+static void shrink(BlockHeader *bp, size_t size) {
+    size_t bs = mm_block_size(bp);
+    if (bs - size < 16)
+        return;
+
+    mm_block_set_header(bp, size, 1);
+    BlockHeader *rest = mm_block_next(bp);
+    mm_block_set_header(rest, bs - size, 0);
+    mm_block_set_prev_allocated(rest, 1);
+    free_coalesce(rest);
+}
+
+/**
+ * Compute the required block size (including space for the header) from the
  * requested payload size.
  *
+ * Allocated blocks have no footer, but a free block needs at least 16 bytes
+ * (header, pointers to previous/next free blocks, footer).
+ *
  * @param payload_size requested payload size
- * @return a block size including header/footer that is a multiple of 8
+ * @return a block size including header that is a multiple of MM_ALIGNMENT
  */
-static int required_block_size(int payload_size) {
-    payload_size += 8;                    // add 8 for for header/footer
-    return ((payload_size + 7) / 8) * 8;  // round up to multiple of 8
+static size_t required_block_size(size_t payload_size) {
+    payload_size += 4;                                // add 4 for header
+    return MAX(16, (payload_size + MM_ALIGNMENT - 1) / MM_ALIGNMENT * MM_ALIGNMENT);
 }
 
-void *mm_malloc(size_t size) {
-    // ignore spurious requests
-    if (size == 0)
+/**
+ * Allocate a block with a payload of `size` bytes starting at an address
+ * multiple of `alignment`; free space before and after the payload is split
+ * into free blocks.
+ *
+ * @param size bytes to assign as an allocated block (multiple of MM_ALIGNMENT)
+ * @param alignment required alignment of the payload (power of 2, larger than
+ *        MM_ALIGNMENT)
+ * @return pointer to the header of the allocated block
+ */
+static BlockHeader *place_aligned(size_t size, size_t alignment) {
+    // leave room for a free block of at least 16 bytes before the payload
+    size_t search_size = size + alignment + 16;
+    BlockHeader *bp = find_fit(search_size);
+    if (bp == NULL && flush_quick_bins())
+        bp = find_fit(search_size);
+    if (bp == NULL) {
+        bp = extend_heap(search_size);
+        if (bp == NULL)
+            return NULL;
+    }
+    size_t bs = mm_block_size(bp);
+    mm_list_remove(bp);
+
+    uintptr_t payload = (uintptr_t)mm_block_payload_addr(bp);
+    uintptr_t aligned = (payload + alignment - 1) & ~(uintptr_t)(alignment - 1);
+    if (aligned != payload && aligned - payload < 16)
+        aligned += alignment;
+    size_t front = aligned - payload;
+
+    BlockHeader *ap = (BlockHeader *)(aligned - 4);
+    mm_block_set_header(ap, bs - front, 1);
+    mm_block_set_prev_allocated(mm_block_next(ap), 1);
+    heap_map(ap, bs - front, 1);
+    if (front > 0) {
+        // free the space before the payload
+        mm_block_set_header(bp, front, 1);
+        free_coalesce(bp);
+    }
+
+    // free the space after the payload
+    shrink(ap, size);
+    return ap;
+}
+
+/**
+ * Allocate a block with a payload of at least `size` bytes.
+ *
+ * @param size requested payload size
+ * @param zeroed set to 1 if the block was taken from a zeroed free block (so,
+ *        only its first MM_BLOCK_LINKS bytes and last word can be non-zero)
+ * @return pointer to the payload, or `NULL` if the heap can't grow
+ */
+static void *allocate(size_t size, int *zeroed) {
+    *zeroed = 0;
+
+    // ignore spurious requests (and sizes that don't fit in a header)
+    if (size == 0 || size > MM_BLOCK_MAX_SIZE - MM_ALIGNMENT)
         return NULL;
 
-    int required_size = required_block_size(size);
-    
+    // tiny objects are packed in runs
+    if (size <= MM_SLAB_MAX) {
+        void *obj = mm_slab_malloc(size);
+        if (obj == NULL) {
+            BlockHeader *run = place_aligned(required_block_size(MM_SLAB_RUN_SIZE), MM_SLAB_RUN_SIZE);
+            if (run == NULL)
+                return NULL;
+            mm_slab_add_run(mm_block_payload_addr(run), size);
+            obj = mm_slab_malloc(size);
+        }
+        return obj;
+    }
+
+    // huge blocks get a mapping of their own (fresh, so zeroed)
+    if (size >= MM_MMAP_THRESHOLD) {
+        BlockHeader *bp = map_block(size, MM_ALIGNMENT);
+        *zeroed = (bp != NULL);
+        return (bp == NULL) ? NULL : mm_block_payload_addr(bp);
+    }
+
+    // sizes that are often freed and then too small get rounded up
+    size_t required_size = mm_round_size(required_block_size(size));
+
+    // recently freed blocks of the same size are ready to use
+    BlockHeader *bp = mm_quick_pop(required_size);
+    if (bp != NULL)
+        return mm_block_payload_addr(bp);
 
     // TODO: find a free block or extend heap
     // TODO: allocate and return pointer to payload
-    if (required_size == 456) {
-        required_size = 520;
-    }
-    else if (required_size == 120) {
-        required_size = 136;
-    }
     BlockHeader *check_free = find_fit(required_size);
-    if (check_free == NULL) {
-        extend_heap(required_size);
+    if (check_free == NULL && flush_quick_bins())
         check_free = find_fit(required_size);
+    if (check_free == NULL) {
+        mm_round_missed(required_size);
+        check_free = extend_heap(required_size);
+        if (check_free == NULL)
+            return NULL;
     }
-    BlockHeader *bp = place(check_free,required_size);
+    *zeroed = mm_block_zeroed(check_free);
+    bp = place(check_free,required_size);
     return mm_block_payload_addr(bp);
 }
 
+/**
+ * Move to the cache of the thread the objects that other threads freed for it,
+ * freeing (in a batch) those that don't fit.
+ *
+ * @param inbox first object of the list taken from the inbox of the thread
+ */
+static void drain_inbox(void *inbox) {
+    void *overflow = NULL;
+    while (inbox != NULL) {
+        void *next = *(void **)inbox;
+        if (!mm_tcache_push(inbox, usable_size(inbox))) {
+            *(void **)inbox = overflow;
+            overflow = inbox;
+        }
+        inbox = next;
+    }
+
+    if (overflow != NULL) {
+        pthread_mutex_lock(&heap_lock);
+        while (overflow != NULL) {
+            void *next = *(void **)overflow;
+            release(overflow);
+            overflow = next;
+        }
+        pthread_mutex_unlock(&heap_lock);
+    }
+}
+
+/**
+ * Allocate a batch of objects for requests of `size` bytes, adding all of them
+ * but one to the cache of the thread.
+ *
+ * @param size requested payload size (at most MM_TCACHE_MAX)
+ * @return pointer to the payload of the object not cached, or `NULL`
+ */
+static void *fill_tcache(size_t size) {
+    int zeroed;
+    size_t class_size = mm_tcache_class_size(size);
+    void *batch[MM_TCACHE_BATCH];
+    int batch_size = mm_tcache_batch(size);
+    int count = 0;
+    while (count < batch_size) {
+        void *ptr = allocate(class_size, &zeroed);
+        if (ptr == NULL)
+            break;
+        batch[count++] = ptr;
+        if (in_top_band(ptr))
+            break;  // (it would not be cached)
+    }
+    if (count == 0)
+        return NULL;
+
+    // cached in reverse, so that the next requests get the objects in order
+    // (but not at the end of the heap, see top_band)
+    register_thread();
+    for (int i = count - 1; i > 0; i--) {
+        if (in_top_band(batch[i]) || !mm_tcache_push(batch[i], usable_size(batch[i])))
+            release(batch[i]);
+    }
+    return batch[0];
+}
+
+/**
+ * Resize a block in a mapping of its own (moving it to the heap if it becomes
+ * smaller than MM_MMAP_THRESHOLD).
+ *
+ * @param bp pointer to the header of a mapped block
+ * @param size requested payload size
+ * @return pointer to the payload, or `NULL` if the block can't be resized
+ */
+static void *remap_block(BlockHeader *bp, size_t size) {
+    char *ptr = mm_block_payload_addr(bp);
+    if (size < MM_MMAP_THRESHOLD) {
+        int zeroed;
+        void *new_ptr = allocate(size, &zeroed);
+        if (new_ptr != NULL) {
+            memcpy(new_ptr, ptr, size);
+            release(ptr);
+        }
+        return new_ptr;
+    }
+
+    // the payload keeps its offset in the mapping
+    size_t offset = bp[-1];
+    size_t new_size = mapping_size(size, offset);
+    if (new_size == 0 || new_size > MM_BLOCK_MAX_SIZE)
+        return NULL;
+    if (new_size == mm_block_size(bp) + offset - MM_ALIGNMENT)
+        return ptr;
+
+    char *start = mem_remap(mapping_start(bp), new_size);
+    if ((long)start == -1)
+        return NULL;
+    return mm_block_payload_addr(mapped_block(start, new_size, offset));
+}
+
+/**
+ * Resize an allocated object.
+ *
+ * @param ptr address of the payload of the object
+ * @param size requested payload size (more than 0)
+ * @return pointer to the payload (maybe moved), or `NULL` if the heap is full
+ */
+static void *reallocate(void *ptr, size_t size) {
+    int zeroed;
+
+    if (mm_slab_contains(ptr)) {
+        // tiny objects can't grow, move to a new block if needed
+        size_t old_size = mm_slab_size(ptr);
+        if (size <= old_size)
+            return ptr;
+        void *new_ptr = allocate(size, &zeroed);
+        if (new_ptr != NULL) {
+            memcpy(new_ptr, ptr, old_size);
+            release(ptr);
+        }
+        return new_ptr;
+    }
+
+    if (size > MM_BLOCK_MAX_SIZE - MM_ALIGNMENT)
+        return NULL;
+
+    // huge blocks are resized with their mapping
+    BlockHeader *bp = (BlockHeader *)((char *)ptr - 4);
+    if (mm_block_mapped(bp))
+        return remap_block(bp, size);
+
+    size_t required_size = required_block_size(size);
+    size_t bs = mm_block_size(bp);
+    if (required_size <= bs) {
+        return ptr;
+    }
+
+    // free blocks around bp
+    BlockHeader *next = mm_block_next(bp);
+    size_t next_size = mm_block_allocated(next) ? 0 : mm_block_size(next);
+    BlockHeader *prev = mm_block_prev_allocated(bp) ? NULL : mm_block_prev(bp);
+    size_t prev_size = (prev == NULL) ? 0 : mm_block_size(prev);
+
+    // last block on the heap (maybe followed by a free block): extend the heap,
+    // if there is room in its region
+    BlockHeader *after_next = (next_size > 0) ? mm_block_next(next) : next;
+    size_t missing = (bs + next_size < required_size) ? MAX(required_size - bs - next_size, 16) : 0;
+    if (missing > 0 && at_break(after_next) && missing <= mem_room()) {
+        if (extend_heap(missing) != NULL) {
+            next_size = mm_block_size(next);  // coalesced with the new space
+        }
+    }
+
+    if (bs + next_size >= required_size) {
+        // grow into the next block, no need to copy
+        mm_list_remove(next);
+        mm_block_set_header(bp, bs + next_size, 1);
+        mm_block_set_prev_allocated(mm_block_next(bp), 1);
+        heap_map(bp, bs + next_size, 1);
+        shrink(bp, required_size);
+        return ptr;
+
+    } else if (bs + next_size + prev_size >= required_size) {
+        // grow into the previous (and next) block, move payload back
+        mm_list_remove(prev);
+        if (next_size > 0) {
+            mm_list_remove(next);
+        }
+        memmove(mm_block_payload_addr(prev), ptr, bs - 4);
+        mm_block_set_header(prev, prev_size + bs + next_size, 1);
+        mm_block_set_prev_allocated(mm_block_next(prev), 1);
+        heap_map(prev, prev_size + bs + next_size, 1);
+        shrink(prev, required_size);
+        return mm_block_payload_addr(prev);
+
+    } else {
+        // move to a new block
+        void *new_ptr = allocate(size, &zeroed);
+        if (new_ptr != NULL) {
+            memcpy(new_ptr, ptr, MIN(size, bs - 4));
+            release(ptr);
+        }
+        return new_ptr;
+    }
+}
+
+void *mm_malloc(size_t size) {
+    // objects freed by other threads come back to the cache in a batch
+    void *inbox = mm_tcache_take_inbox();
+    if (inbox != NULL)
+        drain_inbox(inbox);
+
+    // small objects freed by this thread are reused without locking
+    void *ptr = mm_tcache_pop(size);
+    if (ptr != NULL)
+        return ptr;
+
+    int zeroed;
+    pthread_mutex_lock(&heap_lock);
+    if (size <= MM_TCACHE_MAX)
+        ptr = fill_tcache(size);
+    else
+        ptr = allocate(size, &zeroed);
+    pthread_mutex_unlock(&heap_lock);
+    if (ptr != NULL && size <= MM_TCACHE_MAX)
+        mm_tcache_set_owner(ptr);
+    return ptr;
+}
+
+void mm_free(void *ptr) {
+    if (ptr == NULL)
+        return;
+
+    // small objects go back to the inbox of the thread that allocated them,
+    // or are cached by this thread, without locking
+    size_t size = usable_size(ptr);
+    if (mm_tcache_remote_free(ptr, size))
+        return;
+    register_thread();
+    int top = in_top_band(ptr);
+    if (!top && mm_tcache_push(ptr, size))
+        return;
+
+    // when its list is full, free the object with a batch of the list (only
+    // the object, at the end of the heap)
+    pthread_mutex_lock(&heap_lock);
+    void *cached;
+    for (int i = 0; !top && i < MM_TCACHE_BATCH && (cached = mm_tcache_pop_class(size)) != NULL; i++)
+        release(cached);
+    release(ptr);
+    pthread_mutex_unlock(&heap_lock);
+}
+
+void *mm_calloc(size_t nmemb, size_t size) {
+    // check for overflow of the total size
+    if (nmemb != 0 && size > SIZE_MAX / nmemb)
+        return NULL;
+    size *= nmemb;
+
+    int zeroed;
+    pthread_mutex_lock(&heap_lock);
+    char *ptr = allocate(size, &zeroed);
+    pthread_mutex_unlock(&heap_lock);
+    if (ptr == NULL || !zeroed) {
+        if (ptr != NULL)
+            memset(ptr, 0, size);
+        return ptr;
+    }
+
+    // fresh mappings were never written (the header is read as in usable_size)
+    BlockHeader header = __atomic_load_n((BlockHeader *)(ptr - 4), __ATOMIC_RELAXED);
+    if (mm_block_mapped(&header))
+        return ptr;
+
+    // from virgin memory: clear only the words written while the block was free
+    size_t payload_size = mm_block_size(&header) - 4;
+    memset(ptr, 0, MIN(MM_BLOCK_LINKS, payload_size));
+    memset(ptr + payload_size - 4, 0, 4);
+    return ptr;
+}
+
+void *mm_memalign(size_t alignment, size_t size) {
+    // alignment must be a power of 2
+    if (alignment == 0 || (alignment & (alignment - 1)) != 0)
+        return NULL;
+
+    // all payloads are aligned to MM_ALIGNMENT
+    if (alignment <= MM_ALIGNMENT)
+        return mm_malloc(size);
+
+    if (size == 0)
+        return NULL;
+
+    // huge blocks (or alignments) get a mapping of their own, large enough to
+    // align the payload
+    BlockHeader *bp;
+    pthread_mutex_lock(&heap_lock);
+    if (size >= MM_MMAP_THRESHOLD || alignment >= MM_MMAP_THRESHOLD)
+        bp = map_block(size, alignment);
+    else
+        bp = place_aligned(required_block_size(size), alignment);
+    pthread_mutex_unlock(&heap_lock);
+    return (bp == NULL) ? NULL : mm_block_payload_addr(bp);
+}
+
+void *mm_aligned_alloc(size_t alignment, size_t size) {
+    return mm_memalign(alignment, size);
+}
+
 void *mm_realloc(void *ptr, size_t size) {
 
     if (ptr == NULL) {
@@ -237,130 +1071,118 @@ void *mm_realloc(void *ptr, size_t size) {
         // equivalent to free
         mm_free(ptr);
         return NULL;
+    }
 
-    } else {
-        // TODO: reallocate, reusing current block if possible
-        // TODO: copy data over new block with memcpy
-        // TODO: return pointer to payload of new block
+    pthread_mutex_lock(&heap_lock);
+    void *new_ptr = reallocate(ptr, size);
+    pthread_mutex_unlock(&heap_lock);
+    return new_ptr;
+}
 
+/**
+ * Check the consistency of all the blocks of a region (see mm_check).
+ *
+ * @param prologue pointer to the header of the prologue of the region
+ * @param hi address of the last byte of the region
+ * @return 1 if the region is consistent, 0 otherwise
+ */
+static int check_region(BlockHeader *prologue, char *hi) {
+    BlockHeader *epilogue = (BlockHeader *)(hi + 1) - 1;
+    int prev_allocated = 1;
+    for (BlockHeader *bp = prologue; bp != epilogue; bp = mm_block_next(bp)) {
+        size_t size = mm_block_size(bp);
+        int allocated = mm_block_allocated(bp);
+        BlockHeader *next = (BlockHeader *)((char *)bp + size);
 
-        // TODO: remove this naive implementation
-        int required_size = required_block_size(size);
-        BlockHeader *curr = (BlockHeader *)((char *)ptr - 4);
-        int bs = mm_block_size(curr);
-        int total_size = bs;
-        int check_next = mm_block_allocated(mm_block_next(curr));
-        int check_prev = mm_block_allocated(mm_block_prev(curr));
+        // sizes must be valid, prev_allocated bits up to date
+        if (size < 8 || size % 8 != 0 || next > epilogue)
+            return 0;
+        if (mm_block_prev_allocated(bp) != prev_allocated)
+            return 0;
 
-        if (!check_next) {
-            total_size += mm_block_size(mm_block_next(curr));
-        }
-        if (!check_prev) {
-            total_size += mm_block_size(mm_block_prev(curr));
-        }
+        // free blocks must have a matching footer, and be coalesced
+        BlockHeader *footer = next - 1;
+        if (!allocated && (mm_block_size(footer) != size || mm_block_allocated(footer)))
+            return 0;
+        if (!allocated && !prev_allocated)
+            return 0;
 
-        if (total_size < required_size) {
-            void *new_ptr = mm_malloc(size);
-            memcpy(new_ptr, ptr, MIN(size, (unsigned)mm_block_size(ptr-4) - 8));
-            mm_free(ptr);
-            return new_ptr;
-        }
-        else {
-            if (required_size <= bs) {
-                return mm_block_payload_addr(curr); 
-            }
-            else {
-                if (!check_prev && check_next) {
-                    BlockHeader *previous = mm_block_prev(curr);
-                    int prev_size = mm_block_size(previous);
-                    mm_list_remove(previous);
-                    memmove(mm_block_payload_addr(previous),ptr,size);
-                    if (bs + prev_size - required_size > 16) {
-                        mm_block_set_header(previous,required_size,1);
-                        mm_block_set_footer(previous,required_size,1);
-                        BlockHeader *new_free = mm_block_next(previous);
-                        mm_block_set_header(new_free,bs + prev_size - required_size,1);
-                        mm_block_set_footer(new_free,bs + prev_size - required_size,1);
-                        mm_free(mm_block_payload_addr(new_free));
-                    }
-                    else {
-                        mm_block_set_header(previous,bs + prev_size,1);
-                        mm_block_set_footer(previous,bs + prev_size,1);
-                    }
-                    
-                    return mm_block_payload_addr(previous);
-                }
-                else if (check_prev && !check_next) {
-                    BlockHeader *next = mm_block_next(curr);
-                    int next_size = mm_block_size(next);
-                    mm_list_remove(next);
-                    if (bs + next_size - required_size > 16) {
-                        mm_block_set_header(curr,required_size,1);
-                        mm_block_set_footer(curr,required_size,1);
-                        BlockHeader *new_free = mm_block_next(curr);
-                        mm_block_set_header(new_free,bs + next_size - required_size,1);
-                        mm_block_set_footer(new_free,bs + next_size - required_size,1);
-                        mm_free(mm_block_payload_addr(new_free));
-                    }
-                    else {
-                        mm_block_set_header(curr,bs + next_size,1);
-                        mm_block_set_footer(curr,bs + next_size,1);
-                    }
-                    return ptr;
-                }
-                else if (!check_prev && !check_next) {
-                    BlockHeader *previous = mm_block_prev(curr);
-                    int prev_size = mm_block_size(previous);
-                    if (required_size <= (bs + prev_size)) {                        
-                        mm_list_remove(previous);
-                        memmove(mm_block_payload_addr(previous),ptr,size);
-                        if (bs + prev_size - required_size > 16) {
-                            mm_block_set_header(previous,required_size,1);
-                            mm_block_set_footer(previous,required_size,1);
-                            BlockHeader *new_free = mm_block_next(previous);
-                            mm_block_set_header(new_free,bs + prev_size - required_size,1);
-                            mm_block_set_footer(new_free,bs + prev_size - required_size,1);
-                            mm_free(mm_block_payload_addr(new_free));
-                        }
-                        else {
-                            mm_block_set_header(previous,bs + prev_size,1);
-                            mm_block_set_footer(previous,bs + prev_size,1);
-                        }
-                        return mm_block_payload_addr(previous);
-                    }
-                    else {
-                        BlockHeader *next = mm_block_next(curr);
-                        int next_size = mm_block_size(next);
-                        mm_list_remove(previous);
-                        mm_list_remove(next);
-                        memmove(mm_block_payload_addr(previous),ptr,size);
-                        if (bs + prev_size + next_size - required_size > 16) {
-                            mm_block_set_header(previous,required_size,1);
-                            mm_block_set_footer(previous,required_size,1);
-                            BlockHeader *new_free = mm_block_next(previous);
-                            mm_block_set_header(new_free,bs + prev_size + next_size - required_size,1);
-                            mm_block_set_footer(new_free,bs + prev_size + next_size - required_size,1);
-                            mm_free(mm_block_payload_addr(new_free));
-                        }
-                        else {
-                            mm_block_set_header(previous,bs + prev_size + next_size,1);
-                            mm_block_set_footer(previous,bs + prev_size + next_size,1);
-                        }
-                        return mm_block_payload_addr(previous);
-                    }
-                }
-            }
+#ifdef MM_HEAP_MAP
+        // the heap map must agree with the header
+        if (allocated && mm_heapmap_next_free(bp, next) != next)
+            return 0;
+        if (!allocated && mm_heapmap_next_allocated(bp, next) != next)
+            return 0;
+#endif
+        prev_allocated = allocated;
+    }
+    return mm_block_allocated(epilogue) && mm_block_prev_allocated(epilogue) == prev_allocated;
+}
+
+/**
+ * Check the blocks of all the regions of the heap (the first one starts at
+ * heap_blocks).
+ *
+ * @return 1 if the heap is consistent, 0 otherwise
+ */
+static int check_heap(void) {
+    for (int i = 0; i < mem_regions(); i++) {
+        BlockHeader *prologue = (i == 0) ? heap_blocks : region_prologue(mem_region_lo(i));
+        if (!check_region(prologue, mem_region_hi(i)))
+            return 0;
+    }
+    return 1;
+}
 
+int mm_check(void) {
+    pthread_mutex_lock(&heap_lock);
+    int consistent = check_heap();
+    pthread_mutex_unlock(&heap_lock);
+    return consistent;
+}
+
+/**
+ * Measure the free blocks of all the regions of the heap (from the heap map,
+ * if enabled, without reading block headers: the gaps between regions are
+ * marked as allocated).
+ *
+ * @param stats where to store the measures
+ */
+void mm_get_stats(MMStats *stats) {
+    pthread_mutex_lock(&heap_lock);
+    stats->heap_size = mem_heapsize();
+#ifdef MM_HEAP_MAP
+    BlockHeader *epilogue = (BlockHeader *)(mem_heap_hi() + 1) - 1;
+    stats->free_bytes = mm_heapmap_free_bytes(epilogue);
+    stats->free_blocks = mm_heapmap_free_runs(epilogue);
+    stats->largest_free = mm_heapmap_largest_free(epilogue);
+#else
+    stats->free_bytes = 0;
+    stats->free_blocks = 0;
+    stats->largest_free = 0;
+    for (int i = 0; i < mem_regions(); i++) {
+        BlockHeader *bp = (i == 0) ? heap_blocks : region_prologue(mem_region_lo(i));
+        for (; mm_block_size(bp) != 0; bp = mm_block_next(bp)) {
+            if (!mm_block_allocated(bp)) {
+                size_t size = mm_block_size(bp);
+                stats->free_bytes += size;
+                stats->free_blocks++;
+                stats->largest_free = MAX(stats->largest_free, size);
+            }
         }
     }
+#endif
+    pthread_mutex_unlock(&heap_lock);
 }
 
 void print_heap() {
-    BlockHeader *temp = heap_blocks;
     int i = 0;
-    while (temp != NULL && mm_block_size(temp) != 0) {
-        printf("BLOCK HEADER %d: size = %d, allocated = %d \n", i, mm_block_size(temp), mm_block_allocated(temp));
-        temp = mm_block_next(temp);
-        i++;
+    for (int r = 0; r < mem_regions(); r++) {
+        BlockHeader *temp = (r == 0) ? heap_blocks : region_prologue(mem_region_lo(r));
+        while (temp != NULL && mm_block_size(temp) != 0) {
+            printf("BLOCK HEADER %d: size = %zu, allocated = %d \n", i, mm_block_size(temp), mm_block_allocated(temp));
+            temp = mm_block_next(temp);
+            i++;
+        }
     }
 }
@@ -2,10 +2,44 @@
 #define __MM_H__
 
 #include <stddef.h>  // size_t
+#include <stdint.h>  // UINTPTR_MAX
+
+/**
+ * Alignment of the payloads returned by mm_malloc: 8 bytes on 32-bit builds,
+ * 16 bytes on 64-bit builds (as expected by the x86-64 ABI).
+ */
+#if UINTPTR_MAX > 0xffffffff
+#define MM_ALIGNMENT 16
+#else
+#define MM_ALIGNMENT 8
+#endif
 
 int   mm_init(void);
 void *mm_malloc(size_t size);
+void *mm_calloc(size_t nmemb, size_t size);
+void *mm_memalign(size_t alignment, size_t size);
+void *mm_aligned_alloc(size_t alignment, size_t size);
 void *mm_realloc(void *ptr, size_t size);
 void  mm_free(void *ptr);
 
+/**
+ * Heap consistency checker, for debugging: returns 1 if all blocks on the heap
+ * are consistent (and agree with the heap map, if enabled), 0 otherwise.
+ */
+int   mm_check(void);
+
+/**
+ * Free space on the heap, measured by mm_get_stats (e.g., to follow the
+ * fragmentation during a trace). Blocks cached for reuse (quick bins, thread
+ * caches) and free objects inside runs count as allocated.
+ */
+typedef struct {
+    size_t heap_size;     // bytes of the heap (all regions and mappings)
+    size_t free_bytes;    // bytes in free blocks
+    size_t free_blocks;   // number of free blocks
+    size_t largest_free;  // size of the largest free block
+} MMStats;
+
+void  mm_get_stats(MMStats *stats);
+
 #endif /* __MM_H__ */
@@ -0,0 +1,131 @@
+#include <mm_arena.h>  // prototypes of functions implemented in this file
+#include <mm.h>        // mm_malloc, mm_free, MM_ALIGNMENT -- to get chunks
+#include <stddef.h>    // NULL
+#include <stdint.h>    // SIZE_MAX -- to check sizes
+
+/**
+ * A chunk starts with a link to the next chunk of the arena; objects follow
+ * (from CHUNK_HEADER bytes after the start, to keep them aligned).
+ */
+typedef struct ArenaChunk {
+    struct ArenaChunk *next;
+} ArenaChunk;
+
+#define CHUNK_HEADER ((sizeof(ArenaChunk) + MM_ALIGNMENT - 1) / MM_ALIGNMENT * MM_ALIGNMENT)
+
+struct MMArena {
+    ArenaChunk *chunks;   // all the chunks of the arena
+    ArenaChunk *first;    // first chunk for small objects, kept on reset
+    ArenaChunk *current;  // chunk where objects are allocated by bumping `next`
+    char *next;           // first free byte of the current chunk
+    char *end;            // end of the current chunk
+};
+
+/**
+ * Create an empty arena (chunks are allocated on the first requests).
+ *
+ * @return pointer to the arena, or `NULL` if it can't be allocated
+ */
+MMArena *mm_arena_create(void) {
+    MMArena *arena = mm_malloc(sizeof(MMArena));
+    if (arena == NULL)
+        return NULL;
+    arena->chunks = NULL;
+    arena->first = NULL;
+    arena->current = NULL;
+    arena->next = NULL;
+    arena->end = NULL;
+    return arena;
+}
+
+/**
+ * Allocate a chunk of `size` bytes and add it to the arena.
+ *
+ * @return pointer to the chunk, or `NULL` if the heap is full
+ */
+static ArenaChunk *add_chunk(MMArena *arena, size_t size) {
+    ArenaChunk *chunk = mm_malloc(size);
+    if (chunk == NULL)
+        return NULL;
+    chunk->next = arena->chunks;
+    arena->chunks = chunk;
+    return chunk;
+}
+
+/**
+ * Allocate an object of `size` bytes in the arena.
+ *
+ * @param arena pointer to the arena
+ * @param size requested size
+ * @return pointer to the object (aligned to MM_ALIGNMENT), or `NULL` if the
+ *         heap is full
+ */
+void *mm_arena_malloc(MMArena *arena, size_t size) {
+    if (size == 0 || size > SIZE_MAX - CHUNK_HEADER - MM_ALIGNMENT)
+        return NULL;
+    size = (size + MM_ALIGNMENT - 1) / MM_ALIGNMENT * MM_ALIGNMENT;
+
+    // common case: bump the pointer
+    if (size <= (size_t)(arena->end - arena->next)) {
+        void *obj = arena->next;
+        arena->next += size;
+        return obj;
+    }
+
+    // large objects get a chunk of their own
+    if (size > MM_ARENA_CHUNK_SIZE / 4) {
+        ArenaChunk *chunk = add_chunk(arena, CHUNK_HEADER + size);
+        return (chunk == NULL) ? NULL : (char *)chunk + CHUNK_HEADER;
+    }
+
+    // otherwise, start a new chunk (the rest of the current one is wasted)
+    ArenaChunk *chunk = add_chunk(arena, MM_ARENA_CHUNK_SIZE);
+    if (chunk == NULL)
+        return NULL;
+    if (arena->first == NULL)
+        arena->first = chunk;
+    arena->current = chunk;
+    arena->next = (char *)chunk + CHUNK_HEADER + size;
+    arena->end = (char *)chunk + MM_ARENA_CHUNK_SIZE;
+    return (char *)chunk + CHUNK_HEADER;
+}
+
+/**
+ * Free all the objects of the arena at once; the first chunk is kept, so that
+ * the next requests can reuse it (the oldest chunk is the one least likely to
+ * keep the heap from being trimmed).
+ *
+ * @param arena pointer to the arena
+ */
+void mm_arena_reset(MMArena *arena) {
+    ArenaChunk *chunk = arena->chunks;
+    while (chunk != NULL) {
+        ArenaChunk *next = chunk->next;
+        if (chunk != arena->first)
+            mm_free(chunk);
+        chunk = next;
+    }
+
+    arena->chunks = arena->first;
+    arena->current = arena->first;
+    if (arena->first != NULL) {
+        arena->first->next = NULL;
+        arena->next = (char *)arena->first + CHUNK_HEADER;
+        arena->end = (char *)arena->first + MM_ARENA_CHUNK_SIZE;
+    }
+}
+
+/**
+ * Free all the objects of the arena, and the arena itself.
+ *
+ * @param arena pointer to the arena
+ */
+void mm_arena_destroy(MMArena *arena) {
+    ArenaChunk *chunk = arena->chunks;
+    while (chunk != NULL) {
+        ArenaChunk *next = chunk->next;
+        mm_free(chunk);
+        chunk = next;
+    }
+    mm_free(arena);
+}
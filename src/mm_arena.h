@@ -0,0 +1,23 @@
+#ifndef __MM_ARENA_H__
+#define __MM_ARENA_H__
+
+#include <stddef.h>  // size_t
+
+/**
+ * Arenas: objects are allocated by bumping a pointer inside chunks of
+ * MM_ARENA_CHUNK_SIZE bytes (taken from the heap with mm_malloc), and they
+ * can't be freed one by one: mm_arena_reset frees all of them at once (keeping
+ * one chunk for reuse), mm_arena_destroy also frees the arena.
+ *
+ * Requests larger than MM_ARENA_CHUNK_SIZE / 4 get a chunk of their own.
+ */
+#define MM_ARENA_CHUNK_SIZE (64 * 1024)
+
+typedef struct MMArena MMArena;
+
+MMArena *mm_arena_create(void);
+void    *mm_arena_malloc(MMArena *arena, size_t size);
+void     mm_arena_reset(MMArena *arena);
+void     mm_arena_destroy(MMArena *arena);
+
+#endif /* __MM_ARENA_H__ */
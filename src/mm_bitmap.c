@@ -0,0 +1,73 @@
+#include <mm_bitmap.h>  // prototypes of functions implemented in this file
+
+#if MM_LIST_FL_COUNT > 32 || MM_LIST_SL_COUNT > 32
+#error "bitmap words have 32 bits"
+#endif
+
+static unsigned int fl_bitmap;
+static unsigned int sl_bitmap[MM_LIST_FL_COUNT];
+
+/**
+ * Initializes to a bitmap with all classes empty.
+ */
+void mm_bitmap_init() {
+    fl_bitmap = 0;
+    for (int i = 0; i < MM_LIST_FL_COUNT; i++) {
+        sl_bitmap[i] = 0;
+    }
+}
+
+/**
+ * Mark a size class as non-empty.
+ *
+ * @param cls index of the size class
+ */
+void mm_bitmap_set(int cls) {
+    int fl = cls >> MM_LIST_SL_LOG;
+    int sl = cls & (MM_LIST_SL_COUNT - 1);
+    sl_bitmap[fl] |= 1u << sl;
+    fl_bitmap |= 1u << fl;
+}
+
+/**
+ * Mark a size class as empty.
+ *
+ * @param cls index of the size class
+ */
+void mm_bitmap_clear(int cls) {
+    int fl = cls >> MM_LIST_SL_LOG;
+    int sl = cls & (MM_LIST_SL_COUNT - 1);
+    sl_bitmap[fl] &= ~(1u << sl);
+    if (sl_bitmap[fl] == 0) {
+        fl_bitmap &= ~(1u << fl);
+    }
+}
+
+/**
+ * Find the smallest non-empty size class greater or equal to `cls`.
+ *
+ * Takes constant time: at most two "find first set" on bitmap words.
+ *
+ * @param cls index of the smallest acceptable size class
+ * @return index of a non-empty size class or -1 if they are all empty
+ */
+int mm_bitmap_find(int cls) {
+    if (cls >= MM_LIST_CLASSES) {
+        return -1;
+    }
+
+    // look for a class in the same range first
+    int fl = cls >> MM_LIST_SL_LOG;
+    int sl = cls & (MM_LIST_SL_COUNT - 1);
+    unsigned int sl_map = sl_bitmap[fl] & (~0u << sl);
+    if (sl_map == 0) {
+        // then for the first non-empty range above it
+        unsigned int fl_map = fl + 1 < 32 ? fl_bitmap & (~0u << (fl + 1)) : 0;
+        if (fl_map == 0) {
+            return -1;
+        }
+        fl = __builtin_ctz(fl_map);
+        sl_map = sl_bitmap[fl];
+    }
+    return (fl << MM_LIST_SL_LOG) + __builtin_ctz(sl_map);
+}
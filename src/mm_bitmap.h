@@ -0,0 +1,18 @@
+#ifndef __MM_BITMAP_H__
+#define __MM_BITMAP_H__
+
+#include <mm_list.h>  // MM_LIST_FL_COUNT, MM_LIST_SL_COUNT
+
+/**
+ * Two-level bitmap of the non-empty size classes of the free list:
+ * - bit `fl` of the first-level word is set when any class in the range `fl`
+ *   is non-empty;
+ * - bit `sl` of the second-level word of range `fl` is set when the class
+ *   `fl * MM_LIST_SL_COUNT + sl` is non-empty.
+ */
+void mm_bitmap_init();
+void mm_bitmap_set(int cls);
+void mm_bitmap_clear(int cls);
+int mm_bitmap_find(int cls);
+
+#endif /* __MM_BITMAP_H__ */
@@ -1,27 +1,71 @@
 #ifndef __MM_BLOCK_H__
 #define __MM_BLOCK_H__
 
+#include <mm.h>      // MM_ALIGNMENT
+#include <stddef.h>  // size_t
+
 /**
- * A block header uses 4 bytes for:
- * - a block size, multiple of 8 (so, the last 3 bits are always 0's)
+ * A block header uses 4 bytes (also on 64-bit builds) for:
+ * - a block size, multiple of MM_ALIGNMENT (so, the last 3 bits are always 0's)
  * - an allocated bit (stored as LSB, since the last 3 bits are not needed)
+ * - a "previous block allocated" bit (stored in the second LSB)
+ * - a "zeroed" bit for free blocks (stored in the third LSB): all the bytes
+ *   of the block are 0's except header, footer, and the first MM_BLOCK_LINKS
+ *   bytes of payload (used for links by the free lists)
+ * - a "mapped" bit for allocated blocks (also the third LSB): the block is
+ *   not on the heap, but in a mapping of its own (of the block size, with the
+ *   header MM_ALIGNMENT - 4 bytes after its start)
  *
- * A block footer has the same format.
+ * Only free blocks have a footer, with the same size and allocated bit; so,
+ * the previous block can be found (with mm_block_prev) only when it is free.
  * Check Figure 9.48(a) in the textbook.
+ *
+ * Payloads are aligned to MM_ALIGNMENT, so headers are 4 bytes before a
+ * multiple of MM_ALIGNMENT.
+ */
+typedef unsigned int BlockHeader;
+
+/**
+ * Largest block size that fits in a header.
  */
-typedef int BlockHeader;
+#define MM_BLOCK_MAX_SIZE (0xffffffffu & ~(MM_ALIGNMENT - 1))
+
+/**
+ * Free lists link blocks with 4-byte offsets from heap_blocks (0 for `NULL`,
+ * since the prologue is never linked), so that a free block fits in 16 bytes
+ * also on 64-bit builds. Offsets count 4-byte units (the size of a header), so
+ * links reach blocks up to 16 GiB after heap_blocks (in any region of the
+ * heap). Links use the first MM_BLOCK_LINKS bytes of payload.
+ */
+typedef unsigned int BlockLink;
+
+#define MM_BLOCK_LINKS 16
 
 /**
  * Points to the first block on the heap.
  */
 extern BlockHeader *heap_blocks;
 
-int mm_block_size(BlockHeader *bp);
+#ifdef MM_BLOCK_INLINE
+// accessors defined here, so that they can be inlined by the compiler
+#define MM_BLOCK_FN static inline
+#include <mm_block_impl.h>
+#else
+size_t mm_block_size(BlockHeader *bp);
 int mm_block_allocated(BlockHeader *bp);
-void mm_block_set_header(BlockHeader *bp, int size, int allocated);
-void mm_block_set_footer(BlockHeader *bp, int size, int allocated);
+int mm_block_prev_allocated(BlockHeader *bp);
+int mm_block_zeroed(BlockHeader *bp);
+int mm_block_mapped(BlockHeader *bp);
+void mm_block_set_header(BlockHeader *bp, size_t size, int allocated);
+void mm_block_set_prev_allocated(BlockHeader *bp, int prev_allocated);
+void mm_block_set_zeroed(BlockHeader *bp, int zeroed);
+void mm_block_set_mapped(BlockHeader *bp, int mapped);
+void mm_block_set_footer(BlockHeader *bp, size_t size, int allocated);
 char *mm_block_payload_addr(BlockHeader *bp);
 BlockHeader *mm_block_prev(BlockHeader *bp);
 BlockHeader *mm_block_next(BlockHeader *bp);
+BlockLink mm_block_link(BlockHeader *bp);
+BlockHeader *mm_block_from_link(BlockLink link);
+#endif
 
 #endif /* __MM_BLOCK_H__ */
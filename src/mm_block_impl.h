@@ -0,0 +1,187 @@
+#ifndef __MM_BLOCK_IMPL_H__
+#define __MM_BLOCK_IMPL_H__
+
+/**
+ * Definitions of the block accessors, included by mm_block.h as static inline
+ * functions (when MM_BLOCK_INLINE is defined) or by mm_block.c otherwise.
+ */
+
+/**
+ * Read the size field from a block header (or footer).
+ *
+ * @param bp address of the block header (or footer)
+ * @return size in bytes
+ */
+MM_BLOCK_FN size_t mm_block_size(BlockHeader *bp) {
+    return (*bp) & ~7;  // discard last 3 bits
+}
+
+/**
+ * Read the allocated bit from a block header (or footer).
+ *
+ * @param bp address of the block header (or footer)
+ * @return allocated bit (either 0 or 1)
+ */
+MM_BLOCK_FN int mm_block_allocated(BlockHeader *bp) {
+    return (*bp) & 1;   // get last bit
+}
+
+/**
+ * Read the "previous block allocated" bit from a block header.
+ *
+ * @param bp address of the block header
+ * @return 1 if the previous block on the heap is allocated, 0 if it is free
+ */
+MM_BLOCK_FN int mm_block_prev_allocated(BlockHeader *bp) {
+    return ((*bp) >> 1) & 1;  // get second to last bit
+}
+
+/**
+ * Read the "zeroed" bit from a block header.
+ *
+ * @param bp address of the block header
+ * @return 1 if the free block is known to contain 0's, 0 otherwise
+ */
+MM_BLOCK_FN int mm_block_zeroed(BlockHeader *bp) {
+    return ((*bp) >> 2) & 1;  // get third to last bit
+}
+
+/**
+ * Read the "mapped" bit from a block header.
+ *
+ * @param bp address of the block header
+ * @return 1 if the block is allocated in a mapping of its own, 0 otherwise
+ */
+MM_BLOCK_FN int mm_block_mapped(BlockHeader *bp) {
+    return ((*bp) & 5) == 5;  // third to last bit, on an allocated block
+}
+
+/**
+ * Write the size and allocated bit of a given block inside its header.
+ *
+ * The "previous block allocated" bit is left unchanged: for a new header,
+ * it must be written with mm_block_set_prev_allocated. The "zeroed" bit is
+ * cleared (so is the "mapped" bit).
+ *
+ * @param bp address of the block header
+ * @param size size in bytes (must be a multiple of MM_ALIGNMENT)
+ * @param allocated either 0 or 1
+ */
+MM_BLOCK_FN void mm_block_set_header(BlockHeader *bp, size_t size, int allocated) {
+    *bp = (BlockHeader)size | ((*bp) & 2) | allocated;
+}
+
+/**
+ * Write the "previous block allocated" bit of a given block inside its header.
+ *
+ * The block can be allocated to another thread, which reads its size without
+ * locking the heap: the header is written with a single atomic store.
+ *
+ * @param bp address of the block header
+ * @param prev_allocated either 0 or 1
+ */
+MM_BLOCK_FN void mm_block_set_prev_allocated(BlockHeader *bp, int prev_allocated) {
+    __atomic_store_n(bp, ((*bp) & ~2) | (prev_allocated << 1), __ATOMIC_RELAXED);
+}
+
+/**
+ * Write the "zeroed" bit of a given (free) block inside its header.
+ *
+ * @param bp address of the block header
+ * @param zeroed either 0 or 1
+ */
+MM_BLOCK_FN void mm_block_set_zeroed(BlockHeader *bp, int zeroed) {
+    *bp = ((*bp) & ~4) | (zeroed << 2);
+}
+
+/**
+ * Write the "mapped" bit of a given (allocated) block inside its header.
+ *
+ * @param bp address of the block header
+ * @param mapped either 0 or 1
+ */
+MM_BLOCK_FN void mm_block_set_mapped(BlockHeader *bp, int mapped) {
+    *bp = ((*bp) & ~4) | (mapped << 2);
+}
+
+/**
+ * Write the size and allocated bit of a given block inside its footer.
+ *
+ * Only free blocks (and the prologue) need a footer.
+ *
+ * @param bp address of the block header
+ * @param size size in bytes (must be a multiple of MM_ALIGNMENT)
+ * @param allocated either 0 or 1
+ */
+MM_BLOCK_FN void mm_block_set_footer(BlockHeader *bp, size_t size, int allocated) {
+    BlockHeader *footer_addr = (BlockHeader *)((char *)bp + mm_block_size(bp) - 4);
+    // the footer has the same format as the header
+    *footer_addr = (BlockHeader)size | allocated;
+}
+
+/**
+ * Find the payload starting address given the address of a block header.
+ *
+ * The block header is 4 bytes, so the payload starts after 4 bytes.
+ *
+ * @param bp address of the block header
+ * @return address of the payload for this block
+ */
+MM_BLOCK_FN char *mm_block_payload_addr(BlockHeader *bp) {
+    return (char *)(bp + 1);
+}
+
+/**
+ * Find the header address of the previous block on the heap.
+ *
+ * Only works when the previous block is free (allocated blocks have no footer).
+ *
+ * @param bp address of a block header
+ * @return address of the header of the previous block
+ */
+MM_BLOCK_FN BlockHeader *mm_block_prev(BlockHeader *bp) {
+    // move back by 4 bytes to find the footer of the previous block
+    BlockHeader *previous_footer = bp - 1;
+    size_t previous_size = mm_block_size(previous_footer);
+    char *previous_addr = (char *)bp - previous_size;
+    return (BlockHeader *)previous_addr;
+}
+
+/**
+ * Find the header address of the next block on the heap.
+ *
+ * @param bp address of a block header
+ * @return address of the header of the next block
+ */
+MM_BLOCK_FN BlockHeader *mm_block_next(BlockHeader *bp) {
+    size_t this_size = mm_block_size(bp);
+
+    // TODO: to implement, look at get_prev
+    char *next_addr = (char *)bp + this_size;
+
+    return (BlockHeader *)next_addr;
+}
+
+/**
+ * Encode the address of a block as a link (offset from heap_blocks, in 4-byte
+ * units).
+ *
+ * @param bp address of a block header after heap_blocks, or `NULL`
+ * @return link to the block (0 for `NULL`)
+ */
+MM_BLOCK_FN BlockLink mm_block_link(BlockHeader *bp) {
+    return (bp == NULL) ? 0 : (BlockLink)((size_t)((char *)bp - (char *)heap_blocks) / 4);
+}
+
+/**
+ * Decode a link (offset from heap_blocks, in 4-byte units) into the address of
+ * a block.
+ *
+ * @param link link to a block, or 0
+ * @return address of the block header (`NULL` for 0)
+ */
+MM_BLOCK_FN BlockHeader *mm_block_from_link(BlockLink link) {
+    return (link == 0) ? NULL : (BlockHeader *)((char *)heap_blocks + (size_t)link * 4);
+}
+
+#endif /* __MM_BLOCK_IMPL_H__ */
@@ -0,0 +1,256 @@
+#include <mm_heapmap.h>  // prototypes of functions implemented in this file
+#include <memlib.h>      // MEM_RESERVED -- to size the map
+#include <stdint.h>      // uint64_t
+#include <string.h>      // memset
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>   // _mm256_..., _mm_... -- to compare many words at once
+#endif
+
+#define WORDS (MEM_RESERVED / MM_HEAPMAP_GRANULE / 64 + 1)
+
+/**
+ * Bit `i % 64` of word `i / 64` is set when granule `i` is allocated.
+ */
+static uint64_t map[WORDS];
+
+/**
+ * Words after this one have never been set (so, they don't need to be cleared).
+ */
+static size_t used_words;
+
+/**
+ * Address of granule 0.
+ */
+static char *map_base;
+
+/**
+ * Initializes to a map with all granules free.
+ *
+ * @param base address of the first granule (the heap map covers MEM_RESERVED
+ *        bytes after it)
+ */
+void mm_heapmap_init(BlockHeader *base) {
+    memset(map, 0, used_words * sizeof(map[0]));
+    used_words = 0;
+    map_base = (char *)base;
+}
+
+/**
+ * Index of the granule starting at `bp`.
+ */
+static size_t granule(BlockHeader *bp) {
+    return ((char *)bp - map_base) / MM_HEAPMAP_GRANULE;
+}
+
+/**
+ * Set (or clear) the bits of granules from `i` (included) to `j` (excluded).
+ */
+static void fill(size_t i, size_t j, int allocated) {
+    if (i >= j)
+        return;
+
+    size_t k = i / 64;
+    size_t last = (j - 1) / 64;
+    if (allocated && last >= used_words)
+        used_words = last + 1;
+    uint64_t mask = ~0ull << (i % 64);
+    for (; k <= last; k++) {
+        if (k == last)
+            mask &= ~0ull >> (63 - (j - 1) % 64);
+        if (allocated)
+            map[k] |= mask;
+        else
+            map[k] &= ~mask;
+        mask = ~0ull;
+    }
+}
+
+/**
+ * Mark the granules of a block as allocated.
+ *
+ * @param bp address of the block header
+ * @param size size of the block in bytes (multiple of 8)
+ */
+void mm_heapmap_set(BlockHeader *bp, size_t size) {
+    size_t i = granule(bp);
+    fill(i, i + size / MM_HEAPMAP_GRANULE, 1);
+}
+
+/**
+ * Mark the granules of a block as free.
+ *
+ * @param bp address of the block header
+ * @param size size of the block in bytes (multiple of 8)
+ */
+void mm_heapmap_clear(BlockHeader *bp, size_t size) {
+    size_t i = granule(bp);
+    fill(i, i + size / MM_HEAPMAP_GRANULE, 0);
+}
+
+/**
+ * Check whether the granule at `bp` is allocated.
+ *
+ * @param bp address of a granule (e.g., of a block header)
+ * @return 1 if allocated, 0 otherwise
+ */
+int mm_heapmap_allocated(BlockHeader *bp) {
+    size_t i = granule(bp);
+    return (map[i / 64] >> (i % 64)) & 1;
+}
+
+/**
+ * Skip the words equal to `pattern` (all 0's or all 1's), starting from word
+ * `k`, comparing 4 (AVX2) or 2 (SSE2) words at a time when possible.
+ *
+ * @return index of the first word different from `pattern`, or `end`
+ */
+static size_t skip_words(size_t k, size_t end, uint64_t pattern) {
+#if defined(__AVX2__)
+    __m256i p = _mm256_set1_epi32((int)pattern);
+    for (; k + 4 <= end; k += 4) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)&map[k]);
+        if (_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, p)) != -1)
+            break;
+    }
+#elif defined(__SSE2__)
+    __m128i p = _mm_set1_epi32((int)pattern);
+    for (; k + 2 <= end; k += 2) {
+        __m128i v = _mm_loadu_si128((const __m128i *)&map[k]);
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(v, p)) != 0xffff)
+            break;
+    }
+#endif
+    while (k < end && map[k] == pattern)
+        k++;
+    return k;
+}
+
+/**
+ * Find the first granule from `i` to `end` (excluded) whose bit is different
+ * from the bits of `pattern` (all 0's to find allocated granules, all 1's to
+ * find free granules).
+ *
+ * @return index of the granule, or `end` if there is none
+ */
+static size_t find_bit(size_t i, size_t end, uint64_t pattern) {
+    if (i >= end)
+        return end;
+
+    size_t k = i / 64;
+    uint64_t w = (map[k] ^ pattern) & (~0ull << (i % 64));
+    if (w == 0) {
+        size_t end_word = (end + 63) / 64;
+        k = skip_words(k + 1, end_word, pattern);
+        if (k >= end_word)
+            return end;
+        w = map[k] ^ pattern;
+    }
+    i = k * 64 + __builtin_ctzll(w);
+    return (i < end) ? i : end;
+}
+
+/**
+ * Find the first free granule from `bp` (included) to `end` (excluded).
+ *
+ * @param bp address of a granule
+ * @param end address of the granule where the search stops (e.g., the epilogue)
+ * @return address of the free granule, or `end` if there is none
+ */
+BlockHeader *mm_heapmap_next_free(BlockHeader *bp, BlockHeader *end) {
+    size_t i = find_bit(granule(bp), granule(end), ~0ull);
+    return (BlockHeader *)(map_base + i * MM_HEAPMAP_GRANULE);
+}
+
+/**
+ * Find the first allocated granule from `bp` (included) to `end` (excluded).
+ *
+ * @param bp address of a granule
+ * @param end address of the granule where the search stops (e.g., the epilogue)
+ * @return address of the allocated granule, or `end` if there is none
+ */
+BlockHeader *mm_heapmap_next_allocated(BlockHeader *bp, BlockHeader *end) {
+    size_t i = find_bit(granule(bp), granule(end), 0);
+    return (BlockHeader *)(map_base + i * MM_HEAPMAP_GRANULE);
+}
+
+/**
+ * Find the first run of at least `size` free bytes from `bp` to `end`.
+ *
+ * Since free blocks are coalesced, the run is a free block (first fit by
+ * address).
+ *
+ * @param bp address of the granule where the search starts
+ * @param end address of the granule where the search stops (e.g., the epilogue)
+ * @param size minimum size of the run in bytes
+ * @return address of the first granule of the run, or `NULL` if there is none
+ */
+BlockHeader *mm_heapmap_find(BlockHeader *bp, BlockHeader *end, size_t size) {
+    size_t n = (size + MM_HEAPMAP_GRANULE - 1) / MM_HEAPMAP_GRANULE;
+    size_t last = granule(end);
+    size_t i = find_bit(granule(bp), last, ~0ull);
+    while (i < last) {
+        size_t j = find_bit(i, last, 0);
+        if (j - i >= n)
+            return (BlockHeader *)(map_base + i * MM_HEAPMAP_GRANULE);
+        i = find_bit(j, last, ~0ull);
+    }
+    return NULL;
+}
+
+/**
+ * Count the free bytes from the first granule to `end`.
+ *
+ * @param end address of the granule where the count stops (e.g., the epilogue)
+ * @return number of free bytes
+ */
+size_t mm_heapmap_free_bytes(BlockHeader *end) {
+    size_t last = granule(end);
+    size_t allocated = 0;
+    for (size_t k = 0; k < last / 64; k++)
+        allocated += __builtin_popcountll(map[k]);
+    if (last % 64 != 0)
+        allocated += __builtin_popcountll(map[last / 64] & ~(~0ull << (last % 64)));
+    return (last - allocated) * MM_HEAPMAP_GRANULE;
+}
+
+/**
+ * Count the runs of free granules from the first granule to `end` (the free
+ * blocks): a run starts at each free granule after an allocated one.
+ *
+ * @param end address of the granule where the count stops (e.g., the epilogue)
+ * @return number of runs
+ */
+size_t mm_heapmap_free_runs(BlockHeader *end) {
+    size_t last = granule(end);
+    size_t runs = 0;
+    uint64_t carry = 1;  // (as if granule -1 were allocated)
+    for (size_t k = 0; k < (last + 63) / 64; k++) {
+        uint64_t starts = ~map[k] & ((map[k] << 1) | carry);
+        if (k == last / 64)
+            starts &= ~(~0ull << (last % 64));
+        runs += __builtin_popcountll(starts);
+        carry = map[k] >> 63;
+    }
+    return runs;
+}
+
+/**
+ * Find the size of the largest run of free bytes from the first granule to
+ * `end` (the largest free block).
+ *
+ * @param end address of the granule where the search stops (e.g., the epilogue)
+ * @return size of the run in bytes (0 if all granules are allocated)
+ */
+size_t mm_heapmap_largest_free(BlockHeader *end) {
+    size_t last = granule(end);
+    size_t largest = 0;
+    size_t i = find_bit(0, last, ~0ull);
+    while (i < last) {
+        size_t j = find_bit(i, last, 0);
+        if (j - i > largest)
+            largest = j - i;
+        i = find_bit(j, last, ~0ull);
+    }
+    return largest * MM_HEAPMAP_GRANULE;
+}
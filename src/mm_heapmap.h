@@ -0,0 +1,30 @@
+#ifndef __MM_HEAPMAP_H__
+#define __MM_HEAPMAP_H__
+
+#include <mm_block.h>  // BlockHeader
+#include <stddef.h>    // size_t
+
+/**
+ * Heap map: a side bitmap with one bit for each 8-byte granule of the heap
+ * (counting from a base address, the prologue header), set when the granule
+ * belongs to an allocated block.
+ *
+ * Since block sizes are multiples of 8 bytes, blocks start and end on granule
+ * boundaries, and a run of free granules is a free block: free space can be
+ * found (and measured) by scanning the map, without reading block headers.
+ * Scans skip whole words with SSE2 or AVX2, when enabled (e.g., -mavx2).
+ */
+#define MM_HEAPMAP_GRANULE 8
+
+void mm_heapmap_init(BlockHeader *base);
+void mm_heapmap_set(BlockHeader *bp, size_t size);
+void mm_heapmap_clear(BlockHeader *bp, size_t size);
+int mm_heapmap_allocated(BlockHeader *bp);
+BlockHeader *mm_heapmap_next_free(BlockHeader *bp, BlockHeader *end);
+BlockHeader *mm_heapmap_next_allocated(BlockHeader *bp, BlockHeader *end);
+BlockHeader *mm_heapmap_find(BlockHeader *bp, BlockHeader *end, size_t size);
+size_t mm_heapmap_free_bytes(BlockHeader *end);
+size_t mm_heapmap_free_runs(BlockHeader *end);
+size_t mm_heapmap_largest_free(BlockHeader *end);
+
+#endif /* __MM_HEAPMAP_H__ */
@@ -1,28 +1,79 @@
-#include <mm_list.h>  // prototypes of functions implemented in this file
-#include <unistd.h>   // NULL
+#include <mm_list.h>    // prototypes of functions implemented in this file
+#include <mm_bitmap.h>  // mm_bitmap_... -- to track non-empty size classes
+#include <mm_tree.h>    // mm_tree_... -- to keep large free blocks in a tree
+#include <unistd.h>     // NULL
 
-BlockHeader *mm_list_headp;
-BlockHeader *mm_list_tailp;
+BlockHeader *mm_list_headp[MM_LIST_CLASSES];
+BlockHeader *mm_list_tailp[MM_LIST_CLASSES];
 
 /**
- * Initializes to an empty list.
+ * Initializes all size classes to empty lists (and the tree of large blocks to
+ * an empty tree).
  */
 void mm_list_init() {
-    mm_list_headp = NULL;
-    mm_list_tailp = NULL;
+    for (int i = 0; i < MM_LIST_CLASSES; i++) {
+        mm_list_headp[i] = NULL;
+        mm_list_tailp[i] = NULL;
+    }
+    mm_bitmap_init();
+    mm_tree_init();
+}
+
+/**
+ * Find the size class for a given size (sizes fit in 32 bits, as in headers).
+ */
+static int size_class(unsigned int size) {
+    if (size < (1u << MM_LIST_FL_SHIFT))
+        return size / 8;  // first range: one class every 8 bytes
+
+    // size is in [2^log2, 2^(log2+1)), use the next MM_LIST_SL_LOG bits for sl
+    int log2 = 31 - __builtin_clz(size);
+    int fl = log2 - MM_LIST_FL_SHIFT + 1;
+    int sl = (size >> (log2 - MM_LIST_SL_LOG)) & (MM_LIST_SL_COUNT - 1);
+    return fl * MM_LIST_SL_COUNT + sl;
+}
+
+/**
+ * Find the size class of a block.
+ *
+ * @param size block size in bytes (multiple of MM_ALIGNMENT, at least 16)
+ * @return index of the size class, between 0 and MM_LIST_CLASSES-1
+ */
+int mm_list_class(size_t size) {
+    return size_class(size);
+}
+
+/**
+ * Find the smallest size class whose blocks are all greater or equal to
+ * `size` (the class of `size` if `size` is its lower bound, the next one
+ * otherwise).
+ *
+ * @param size block size in bytes (multiple of MM_ALIGNMENT, at least 16)
+ * @return index of the size class (MM_LIST_CLASSES if no class qualifies)
+ */
+int mm_list_fit_class(size_t size) {
+    unsigned int rounded = size;
+    if (rounded >= (1u << MM_LIST_FL_SHIFT)) {
+        int log2 = 31 - __builtin_clz(rounded);
+        rounded += (1u << (log2 - MM_LIST_SL_LOG)) - 1;
+        if (rounded < size)
+            return MM_LIST_CLASSES;  // past the last class
+    }
+    int cls = size_class(rounded);
+    return cls < MM_LIST_CLASSES ? cls : MM_LIST_CLASSES;
 }
 
 /**
  * In addition to the block header with size/allocated bit, a free block has
- * pointers to the headers of the previous and next blocks on the free list.
+ * links to the headers of the previous and next blocks on the free list.
  *
- * Pointers use 4 bytes because this project is compiled with -m32.
+ * Links use 4 bytes (offsets from heap_blocks), also on 64-bit builds.
  * Check Figure 9.48(b) in the textbook.
  */
 typedef struct {
     BlockHeader header;
-    BlockHeader *prev_free;
-    BlockHeader *next_free;
+    BlockLink prev_free;
+    BlockLink next_free;
 } FreeBlockHeader;
 
 /**
@@ -33,7 +84,7 @@ typedef struct {
  */
 BlockHeader *mm_list_prev(BlockHeader *bp) {
     FreeBlockHeader *fp = (FreeBlockHeader *)bp;
-    return fp->prev_free;
+    return mm_block_from_link(fp->prev_free);
 }
 
 /**
@@ -44,7 +95,7 @@ BlockHeader *mm_list_prev(BlockHeader *bp) {
  */
 BlockHeader *mm_list_next(BlockHeader *bp) {
     FreeBlockHeader *fp = (FreeBlockHeader *)bp;
-    return fp->next_free;
+    return mm_block_from_link(fp->next_free);
 }
 
 /**
@@ -55,7 +106,7 @@ BlockHeader *mm_list_next(BlockHeader *bp) {
  */
 static void mm_list_prev_set(BlockHeader *bp, BlockHeader *prev) {
     FreeBlockHeader *fp = (FreeBlockHeader *)bp;
-    fp->prev_free = prev;
+    fp->prev_free = mm_block_link(prev);
 }
 
 
@@ -67,78 +118,101 @@ static void mm_list_prev_set(BlockHeader *bp, BlockHeader *prev) {
  */
 static void mm_list_next_set(BlockHeader *bp, BlockHeader *next) {
     FreeBlockHeader *fp = (FreeBlockHeader *)bp;
-    fp->next_free = next;
+    fp->next_free = mm_block_link(next);
 }
 
 /**
- * Add a block at the beginning of the free list.
+ * Add a block at the beginning of the free list of its size class (or to the tree,
+ * if at least MM_TREE_MIN_SIZE bytes).
  *
  * @param bp address of the header of the block to add
  */
 void mm_list_prepend(BlockHeader *bp) {
-    // TODO: implement
-    if (mm_list_headp == NULL) {
-        FreeBlockHeader *fp = (FreeBlockHeader *)bp;
-        fp->next_free = NULL;
-        fp->prev_free = NULL;
-        mm_list_headp = bp;
-        mm_list_tailp = bp;
+    size_t size = mm_block_size(bp);
+    if (size >= MM_TREE_MIN_SIZE) {
+        mm_tree_insert(bp);
+        return;
+    }
+
+    int cls = mm_list_class(size);
+    if (mm_list_headp[cls] == NULL) {
+        mm_list_next_set(bp, NULL);
+        mm_list_prev_set(bp, NULL);
+        mm_list_headp[cls] = bp;
+        mm_list_tailp[cls] = bp;
+        mm_bitmap_set(cls);
     }
     else {
-        FreeBlockHeader *fp = (FreeBlockHeader *)bp;
-        FreeBlockHeader *h = (FreeBlockHeader *)mm_list_headp;
-        fp->next_free = mm_list_headp;
-        fp->prev_free = NULL;
-        h->prev_free = bp;
-        mm_list_headp = bp;
+        mm_list_next_set(bp, mm_list_headp[cls]);
+        mm_list_prev_set(bp, NULL);
+        mm_list_prev_set(mm_list_headp[cls], bp);
+        mm_list_headp[cls] = bp;
     }
 }
 
 /**
- * Add a block at the end of the free list.
+ * Add a block at the end of the free list of its size class (or to the tree,
+ * if at least MM_TREE_MIN_SIZE bytes).
  *
  * @param bp address of the header of the block to add
  */
 void mm_list_append(BlockHeader *bp) {
-    // TODO: implement
-    if (mm_list_headp == NULL) {
-        FreeBlockHeader *fp = (FreeBlockHeader *)bp;
-        fp->next_free = NULL;
-        fp->prev_free = NULL;
-        mm_list_headp = bp;
-        mm_list_tailp = bp;
+    size_t size = mm_block_size(bp);
+    if (size >= MM_TREE_MIN_SIZE) {
+        mm_tree_insert(bp);
+        return;
+    }
+
+    int cls = mm_list_class(size);
+    if (mm_list_headp[cls] == NULL) {
+        mm_list_next_set(bp, NULL);
+        mm_list_prev_set(bp, NULL);
+        mm_list_headp[cls] = bp;
+        mm_list_tailp[cls] = bp;
+        mm_bitmap_set(cls);
     }
     else {
-        FreeBlockHeader *t = (FreeBlockHeader *)mm_list_tailp;
-        FreeBlockHeader *fp = (FreeBlockHeader *)bp;
-        t->next_free = bp;
-        fp->prev_free = mm_list_tailp;
-        fp->next_free = NULL;
-        mm_list_tailp = bp;
+        mm_list_next_set(mm_list_tailp[cls], bp);
+        mm_list_prev_set(bp, mm_list_tailp[cls]);
+        mm_list_next_set(bp, NULL);
+        mm_list_tailp[cls] = bp;
     }
 }
 
 /**
- * Remove a block from the free list.
+ * Remove a block from the free list of its size class (or from the tree, if at
+ * least MM_TREE_MIN_SIZE bytes).
+ *
+ * The block size must not have changed since the block was added.
  *
  * @param bp address of the header of the block to remove
  */
 void mm_list_remove(BlockHeader *bp) {
-    // TODO: implement
-    if (mm_list_headp == NULL) {
+    size_t size = mm_block_size(bp);
+    if (size >= MM_TREE_MIN_SIZE) {
+        mm_tree_remove(bp);
         return;
     }
-    FreeBlockHeader *fp = (FreeBlockHeader *)bp;
-    if (mm_list_headp == bp) {
-        mm_list_headp = fp->next_free;
+
+    int cls = mm_list_class(size);
+    if (mm_list_headp[cls] == NULL) {
+        return;
+    }
+    BlockHeader *prev = mm_list_prev(bp);
+    BlockHeader *next = mm_list_next(bp);
+    if (mm_list_headp[cls] == bp) {
+        mm_list_headp[cls] = next;
+    }
+    if (mm_list_tailp[cls] == bp) {
+        mm_list_tailp[cls] = prev;
     }
-    if (mm_list_tailp == bp) {
-        mm_list_tailp = fp->prev_free;
+    if (next != NULL) {
+        mm_list_prev_set(next,prev);
     }
-    if (fp->next_free != NULL) {
-        mm_list_prev_set(fp->next_free,fp->prev_free);
+    if (prev != NULL) {
+        mm_list_next_set(prev,next);
     }
-    if (fp->prev_free != NULL) {
-        mm_list_next_set(fp->prev_free,fp->next_free);
+    if (mm_list_headp[cls] == NULL) {
+        mm_bitmap_clear(cls);
     }
 }
@@ -4,15 +4,30 @@
 #include <mm_block.h>  // BlockHeader
 
 /**
- * Pointers to the list head and tail (blocks on the heap).
+ * Size classes of the segregated free list (two-level, as in TLSF):
+ * - the first level splits sizes in power-of-two ranges [2^k, 2^(k+1)),
+ *   except the first range [0, 2^MM_LIST_FL_SHIFT) of small blocks;
+ * - the second level splits each range in MM_LIST_SL_COUNT classes of equal
+ *   width (8 bytes for blocks up to 256 bytes, so one class for each size).
  */
-extern BlockHeader *mm_list_headp;
-extern BlockHeader *mm_list_tailp;
+#define MM_LIST_SL_LOG 4
+#define MM_LIST_SL_COUNT (1 << MM_LIST_SL_LOG)
+#define MM_LIST_FL_SHIFT (MM_LIST_SL_LOG + 3)
+#define MM_LIST_FL_COUNT (32 - MM_LIST_FL_SHIFT + 1)
+#define MM_LIST_CLASSES (MM_LIST_FL_COUNT * MM_LIST_SL_COUNT)
+
+/**
+ * Pointers to the head and tail (blocks on the heap) of each size class.
+ */
+extern BlockHeader *mm_list_headp[MM_LIST_CLASSES];
+extern BlockHeader *mm_list_tailp[MM_LIST_CLASSES];
 
 void mm_list_init();
-void mm_list_prepend(int *bp);
-void mm_list_append(int *bp);
-void mm_list_remove(int *bp);
+int mm_list_class(size_t size);
+int mm_list_fit_class(size_t size);
+void mm_list_prepend(BlockHeader *bp);
+void mm_list_append(BlockHeader *bp);
+void mm_list_remove(BlockHeader *bp);
 BlockHeader *mm_list_prev(BlockHeader *bp);
 BlockHeader *mm_list_next(BlockHeader *bp);
 
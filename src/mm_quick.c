@@ -0,0 +1,102 @@
+#include <mm_quick.h>  // prototypes of functions implemented in this file
+#include <stddef.h>    // NULL
+
+#define BINS (MM_QUICK_MAX / 8 + 1)
+#define WORDS ((BINS + 31) / 32)
+
+/**
+ * Heads of the bins (one every 8 bytes); blocks in a bin are linked through
+ * the first word of their payload.
+ */
+static BlockHeader *bins[BINS];
+
+/**
+ * One bit for each non-empty bin, to find cached blocks quickly.
+ */
+static unsigned int used_bins[WORDS];
+
+static size_t cached_bytes;
+
+/**
+ * Initializes to empty bins.
+ */
+void mm_quick_init() {
+    for (int i = 0; i < BINS; i++) {
+        bins[i] = NULL;
+    }
+    for (int i = 0; i < WORDS; i++) {
+        used_bins[i] = 0;
+    }
+    cached_bytes = 0;
+}
+
+static BlockHeader **next_cached(BlockHeader *bp) {
+    return (BlockHeader **)(bp + 1);
+}
+
+/**
+ * Cache a freed block in the bin of its size.
+ *
+ * @param bp address of the header of a block (still marked as allocated)
+ * @return 1 if the block was cached, 0 if it is too large for the bins
+ */
+int mm_quick_push(BlockHeader *bp) {
+    size_t size = mm_block_size(bp);
+    if (size > MM_QUICK_MAX) {
+        return 0;
+    }
+
+    int bin = size / 8;
+    *next_cached(bp) = bins[bin];
+    bins[bin] = bp;
+    used_bins[bin / 32] |= 1u << (bin % 32);
+    cached_bytes += size;
+    return 1;
+}
+
+/**
+ * Take the last cached block of a given size.
+ *
+ * @param size block size (multiple of MM_ALIGNMENT)
+ * @return address of the header of the block, or `NULL` if none is cached
+ */
+BlockHeader *mm_quick_pop(size_t size) {
+    if (size > MM_QUICK_MAX) {
+        return NULL;
+    }
+
+    int bin = size / 8;
+    BlockHeader *bp = bins[bin];
+    if (bp != NULL) {
+        bins[bin] = *next_cached(bp);
+        if (bins[bin] == NULL) {
+            used_bins[bin / 32] &= ~(1u << (bin % 32));
+        }
+        cached_bytes -= size;
+    }
+    return bp;
+}
+
+/**
+ * Take any cached block (to flush the bins).
+ *
+ * @return address of the header of the block, or `NULL` if the bins are empty
+ */
+BlockHeader *mm_quick_pop_any() {
+    for (int i = 0; i < WORDS; i++) {
+        if (used_bins[i] != 0) {
+            int bin = i * 32 + __builtin_ctz(used_bins[i]);
+            return mm_quick_pop(bin * 8);
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Total size of the cached blocks.
+ *
+ * @return bytes in cached blocks
+ */
+size_t mm_quick_bytes() {
+    return cached_bytes;
+}
@@ -0,0 +1,22 @@
+#ifndef __MM_QUICK_H__
+#define __MM_QUICK_H__
+
+#include <mm_block.h>  // BlockHeader
+
+/**
+ * Quick bins: LIFO caches of freed blocks of each exact size up to
+ * MM_QUICK_MAX bytes. Cached blocks are still marked as allocated on the heap
+ * (so, they are not coalesced) until they are flushed in a batch.
+ *
+ * At most MM_QUICK_BUDGET bytes should be cached.
+ */
+#define MM_QUICK_MAX 4096
+#define MM_QUICK_BUDGET (64 * 1024)
+
+void mm_quick_init();
+int mm_quick_push(BlockHeader *bp);
+BlockHeader *mm_quick_pop(size_t size);
+BlockHeader *mm_quick_pop_any();
+size_t mm_quick_bytes();
+
+#endif /* __MM_QUICK_H__ */
@@ -0,0 +1,107 @@
+#include <mm_round.h>  // prototypes of functions implemented in this file
+
+#define BUCKETS (MM_ROUND_MAX / 8)
+
+/**
+ * Votes needed to round a size up (and requests needed for the larger size).
+ */
+#define THRESHOLD 8
+
+/**
+ * Counters are halved after this many frees, so that old events fade away
+ * (with the roundings whose votes fall below THRESHOLD).
+ */
+#define DECAY_PERIOD 1024
+
+/**
+ * For each block size (one bucket every 8 bytes):
+ * - `requested`: recent requests of this size;
+ * - `freed`: recent frees of blocks of this size;
+ * - `votes`: recent requests of a slightly larger size that no free block
+ *   could serve, while blocks of this size were being freed;
+ * - `target`: size to which requests of this size are rounded (0 if none).
+ */
+static unsigned short requested[BUCKETS];
+static unsigned short freed[BUCKETS];
+static unsigned short votes[BUCKETS];
+static unsigned short target[BUCKETS];
+static int frees_since_decay;
+
+/**
+ * Initializes to no rounding and no history.
+ */
+void mm_round_init() {
+    for (int i = 0; i < BUCKETS; i++) {
+        requested[i] = 0;
+        freed[i] = 0;
+        votes[i] = 0;
+        target[i] = 0;
+    }
+    frees_since_decay = 0;
+}
+
+static void count(unsigned short *counter) {
+    if (*counter < 0xffff)
+        (*counter)++;
+}
+
+/**
+ * Round a requested block size according to what was learned so far.
+ *
+ * @param size block size (multiple of 8)
+ * @return block size to allocate instead (multiple of 8, at least `size`)
+ */
+size_t mm_round_size(size_t size) {
+    if (size >= MM_ROUND_MAX)
+        return size;
+
+    int b = size / 8;
+    count(&requested[b]);
+    return target[b] > size ? target[b] : size;
+}
+
+/**
+ * Record that a block was freed.
+ *
+ * @param size size of the freed block (before coalescing)
+ */
+void mm_round_freed(size_t size) {
+    if (size < MM_ROUND_MAX)
+        count(&freed[size / 8]);
+
+    if (++frees_since_decay == DECAY_PERIOD) {
+        frees_since_decay = 0;
+        for (int i = 0; i < BUCKETS; i++) {
+            requested[i] /= 2;
+            freed[i] /= 2;
+            votes[i] /= 2;
+            if (votes[i] < THRESHOLD)
+                target[i] = 0;
+        }
+    }
+}
+
+/**
+ * Record that no free block could serve a request (so the heap is extended),
+ * and vote for rounding up the most freed size slightly below it.
+ *
+ * @param size block size that was requested
+ */
+void mm_round_missed(size_t size) {
+    if (size >= MM_ROUND_MAX)
+        return;
+
+    // most freed size in [size - size/MM_ROUND_SLACK, size)
+    int best = -1;
+    int last = size / 8;
+    for (int b = (size - size / MM_ROUND_SLACK + 7) / 8; b < last; b++) {
+        if (freed[b] > 0 && (best < 0 || freed[b] > freed[best]))
+            best = b;
+    }
+    if (best < 0)
+        return;
+
+    count(&votes[best]);
+    if (votes[best] >= THRESHOLD && requested[size / 8] >= THRESHOLD && target[best] < size)
+        target[best] = size;
+}
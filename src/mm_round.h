@@ -0,0 +1,22 @@
+#ifndef __MM_ROUND_H__
+#define __MM_ROUND_H__
+
+#include <stddef.h>  // size_t
+
+/**
+ * Adaptive rounding of block sizes: if blocks of a size are often freed and
+ * then can't serve requests of a slightly larger size, blocks of that size
+ * are rounded up to the larger one (so that, once freed, they can be reused).
+ *
+ * Only block sizes below MM_ROUND_MAX are tracked, and a size is rounded up to
+ * at most 1/MM_ROUND_SLACK more than itself.
+ */
+#define MM_ROUND_MAX 1024
+#define MM_ROUND_SLACK 8
+
+void mm_round_init();
+size_t mm_round_size(size_t size);
+void mm_round_freed(size_t size);
+void mm_round_missed(size_t size);
+
+#endif /* __MM_ROUND_H__ */
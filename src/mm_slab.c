@@ -0,0 +1,212 @@
+#include <mm_slab.h>  // prototypes of functions implemented in this file
+#include <memlib.h>   // mem_heap_lo, mem_reserved, MEM_RESERVED -- to map heap pages
+#include <stdint.h>   // uintptr_t
+#include <string.h>   // memset
+
+/**
+ * Each run starts with this header, followed by objects of `object_size`
+ * bytes. Objects are handed out from the list of freed objects (linked through
+ * their first word) or, when empty, from the part of the run never used.
+ */
+typedef struct SlabRun {
+    struct SlabRun *prev;  // runs of the same class with free objects
+    struct SlabRun *next;
+    char *free_list;       // freed objects of this run
+    char *unused;          // first object never handed out
+    int object_size;
+    int used;              // objects handed out
+} SlabRun;
+
+#define RUN_OBJECTS_OFFSET ((sizeof(SlabRun) + MM_ALIGNMENT - 1) / MM_ALIGNMENT * MM_ALIGNMENT)
+
+/**
+ * For each size class, the runs that still have free objects.
+ */
+static SlabRun *partial_runs[MM_SLAB_CLASSES];
+
+/**
+ * One bit for each (aligned) page of the heap (of all its regions), set if the
+ * page is a run.
+ */
+static unsigned char run_pages[MEM_RESERVED / MM_SLAB_RUN_SIZE / 8 + 1];
+static uintptr_t first_page;
+
+/**
+ * Initializes to no runs (all the blocks on the heap are forgotten).
+ */
+void mm_slab_init() {
+    for (int i = 0; i < MM_SLAB_CLASSES; i++) {
+        partial_runs[i] = NULL;
+    }
+    memset(run_pages, 0, sizeof(run_pages));
+    first_page = (uintptr_t)mem_heap_lo() / MM_SLAB_RUN_SIZE;
+}
+
+static int size_class(size_t size) {
+    return (size + MM_ALIGNMENT - 1) / MM_ALIGNMENT - 1;
+}
+
+static SlabRun *run_of(void *ptr) {
+    return (SlabRun *)((uintptr_t)ptr & ~(uintptr_t)(MM_SLAB_RUN_SIZE - 1));
+}
+
+// (mm_slab_contains reads the bits of other pages without locking the heap:
+// bytes are written with a single atomic store)
+static void set_run_page(SlabRun *run, int is_run) {
+    uintptr_t page = (uintptr_t)run / MM_SLAB_RUN_SIZE - first_page;
+    unsigned char bits = run_pages[page / 8];
+    if (is_run) {
+        bits |= 1 << (page % 8);
+    } else {
+        bits &= ~(1 << (page % 8));
+    }
+    __atomic_store_n(&run_pages[page / 8], bits, __ATOMIC_RELAXED);
+}
+
+static int run_full(SlabRun *run) {
+    return run->free_list == NULL &&
+           run->unused + run->object_size > (char *)run + MM_SLAB_RUN_SIZE;
+}
+
+static void partial_add(SlabRun *run, int cls) {
+    run->prev = NULL;
+    run->next = partial_runs[cls];
+    if (run->next != NULL) {
+        run->next->prev = run;
+    }
+    partial_runs[cls] = run;
+}
+
+static void partial_remove(SlabRun *run, int cls) {
+    if (run->prev != NULL) {
+        run->prev->next = run->next;
+    } else {
+        partial_runs[cls] = run->next;
+    }
+    if (run->next != NULL) {
+        run->next->prev = run->prev;
+    }
+}
+
+/**
+ * Allocate an object from the runs of the size class of `size`.
+ *
+ * @param size requested payload size (at most MM_SLAB_MAX)
+ * @return address of the object, or `NULL` if the runs of the class are full
+ *         (then, a new run must be added with mm_slab_add_run)
+ */
+void *mm_slab_malloc(size_t size) {
+    int cls = size_class(size);
+    SlabRun *run = partial_runs[cls];
+    if (run == NULL) {
+        return NULL;
+    }
+
+    char *obj;
+    if (run->free_list != NULL) {
+        obj = run->free_list;
+        run->free_list = *(char **)obj;
+    } else {
+        obj = run->unused;
+        run->unused += run->object_size;
+    }
+    run->used++;
+
+    if (run_full(run)) {
+        partial_remove(run, cls);
+    }
+    return obj;
+}
+
+/**
+ * Start a new run for the size class of `size`.
+ *
+ * @param run address of MM_SLAB_RUN_SIZE bytes on the heap, aligned to
+ *        MM_SLAB_RUN_SIZE
+ * @param size requested payload size (at most MM_SLAB_MAX)
+ */
+void mm_slab_add_run(char *run, size_t size) {
+    int cls = size_class(size);
+    SlabRun *rp = (SlabRun *)run;
+    rp->free_list = NULL;
+    rp->unused = run + RUN_OBJECTS_OFFSET;
+    rp->object_size = (cls + 1) * MM_ALIGNMENT;
+    rp->used = 0;
+    partial_add(rp, cls);
+    set_run_page(rp, 1);
+}
+
+/**
+ * Check whether a payload address is an object inside a run.
+ *
+ * @param ptr address returned by mm_malloc
+ * @return 1 if `ptr` is inside a run, 0 otherwise
+ */
+int mm_slab_contains(void *ptr) {
+    // the regions of the heap are inside mem_reserved bytes (pages above the
+    // breaks are never runs): no need to read the breaks, which other threads
+    // may be moving
+    if ((char *)ptr < mem_heap_lo() || (size_t)((char *)ptr - mem_heap_lo()) >= mem_reserved()) {
+        return 0;
+    }
+    uintptr_t page = (uintptr_t)ptr / MM_SLAB_RUN_SIZE - first_page;
+    return (__atomic_load_n(&run_pages[page / 8], __ATOMIC_RELAXED) >> (page % 8)) & 1;
+}
+
+/**
+ * Find the usable size of an object inside a run.
+ *
+ * @param ptr address of an object inside a run
+ * @return the size of objects in its run
+ */
+size_t mm_slab_size(void *ptr) {
+    return run_of(ptr)->object_size;
+}
+
+/**
+ * Give back an object to its run.
+ *
+ * Runs left with no objects are released (unless it is the only run of the
+ * class with free objects and `keep_last` is set, to avoid allocating a run
+ * again on the next call).
+ *
+ * @param ptr address of an object inside a run
+ * @param keep_last 1 to keep the only run of the class, 0 to release it too
+ * @return address of the run to release, or `NULL`
+ */
+char *mm_slab_free(void *ptr, int keep_last) {
+    SlabRun *run = run_of(ptr);
+    int cls = size_class(run->object_size);
+    if (run_full(run)) {
+        partial_add(run, cls);
+    }
+
+    *(char **)ptr = run->free_list;
+    run->free_list = ptr;
+    run->used--;
+
+    if (run->used == 0 && (!keep_last || run->prev != NULL || run->next != NULL)) {
+        partial_remove(run, cls);
+        set_run_page(run, 0);
+        return (char *)run;
+    }
+    return NULL;
+}
+
+/**
+ * Take a run left with no objects (kept as the only run of its class), to
+ * release it.
+ *
+ * @return address of the run, or `NULL` if no run is empty
+ */
+char *mm_slab_pop_empty() {
+    for (int cls = 0; cls < MM_SLAB_CLASSES; cls++) {
+        SlabRun *run = partial_runs[cls];
+        if (run != NULL && run->used == 0) {
+            partial_remove(run, cls);
+            set_run_page(run, 0);
+            return (char *)run;
+        }
+    }
+    return NULL;
+}
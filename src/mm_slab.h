@@ -0,0 +1,24 @@
+#ifndef __MM_SLAB_H__
+#define __MM_SLAB_H__
+
+#include <mm.h>      // MM_ALIGNMENT
+#include <stddef.h>  // size_t
+
+/**
+ * Objects of up to MM_SLAB_MAX bytes are not stored in blocks with a header:
+ * they are packed in runs of MM_SLAB_RUN_SIZE bytes (aligned to their size),
+ * each holding objects of a single size class (multiples of MM_ALIGNMENT).
+ */
+#define MM_SLAB_MAX 64
+#define MM_SLAB_CLASSES (MM_SLAB_MAX / MM_ALIGNMENT)
+#define MM_SLAB_RUN_SIZE 4096
+
+void mm_slab_init();
+void *mm_slab_malloc(size_t size);
+void mm_slab_add_run(char *run, size_t size);
+int mm_slab_contains(void *ptr);
+size_t mm_slab_size(void *ptr);
+char *mm_slab_free(void *ptr, int keep_last);
+char *mm_slab_pop_empty();
+
+#endif /* __MM_SLAB_H__ */
@@ -0,0 +1,302 @@
+#include <mm_tcache.h>  // prototypes of functions implemented in this file
+#include <memlib.h>     // mem_heap_lo, mem_table -- to map objects to their owner
+#include <stdatomic.h>  // atomic_... -- to invalidate caches, push to inboxes
+#include <string.h>     // memset
+
+/**
+ * Cache of a thread: list `i` holds objects with a usable size of at least
+ * `i * MM_ALIGNMENT` bytes (and less than `(i + 1) * MM_ALIGNMENT`), linked
+ * through their first word.
+ */
+typedef struct {
+    void *lists[MM_TCACHE_CLASSES];
+    unsigned short counts[MM_TCACHE_CLASSES];
+    unsigned char batches[MM_TCACHE_CLASSES];  // objects to get on the next miss
+    size_t bytes;
+    unsigned int generation;  // heap of the cached objects
+} ThreadCache;
+
+static _Thread_local ThreadCache cache;
+
+/**
+ * Incremented when the heap is initialized again: objects cached by threads
+ * for an older heap must be forgotten.
+ */
+static atomic_uint generation = 1;
+
+/**
+ * Inboxes of the threads, indexed by thread id (from 1): objects freed by other
+ * threads than their owner, linked through their first word. Other threads
+ * push with a CAS, the owner takes the whole list at once.
+ *
+ * The inbox of an id that no thread holds is CLOSED: threads that free objects
+ * still tagged with it (their owner has exited) free them themselves.
+ */
+static char closed;
+#define CLOSED ((void *)&closed)
+
+static _Atomic(void *) inboxes[MM_TCACHE_THREADS + 1];
+static atomic_bool ids_taken[MM_TCACHE_THREADS + 1];
+
+/**
+ * Id of the thread that took each object from its cache, one byte for each
+ * MM_ALIGNMENT bytes of the heap (0 if none). Ids are only hints: an object
+ * pushed to the wrong inbox is still cached or freed by the thread that gets it.
+ *
+ * The table covers all the regions of the heap (mem_reserved bytes), so it is
+ * taken from mem_table on the first init: only its pages that are used take
+ * memory. Without room for it (in 32-bit builds), objects are never tagged.
+ */
+static unsigned char *owners;
+
+static _Thread_local unsigned char thread_id;
+
+static unsigned char *owner_of(void *ptr) {
+    return &owners[((char *)ptr - mem_heap_lo()) / MM_ALIGNMENT];
+}
+
+/**
+ * Get the id of the calling thread, taking a free one on the first call (0 if
+ * all are taken: then, objects of the thread are not tagged).
+ */
+static unsigned char get_thread_id(void) {
+    static _Thread_local int tried;
+    if (thread_id == 0 && !tried) {
+        tried = 1;
+        for (int id = 1; id <= MM_TCACHE_THREADS; id++) {
+            if (!atomic_exchange(&ids_taken[id], 1)) {
+                atomic_store(&inboxes[id], NULL);
+                thread_id = id;
+                break;
+            }
+        }
+    }
+    return thread_id;
+}
+
+/**
+ * Get the cache of the calling thread, emptying it if it's from an old heap.
+ */
+static ThreadCache *thread_cache(void) {
+    unsigned int current = atomic_load_explicit(&generation, memory_order_relaxed);
+    if (cache.generation != current) {
+        memset(&cache, 0, sizeof(cache));
+        cache.generation = current;
+    }
+    return &cache;
+}
+
+/**
+ * Initializes to empty caches, for all threads (the objects in them are
+ * forgotten, as when the heap is initialized again).
+ */
+void mm_tcache_init() {
+    if (owners == NULL)
+        owners = (unsigned char *)mem_table(mem_reserved() / MM_ALIGNMENT);
+    atomic_fetch_add_explicit(&generation, 1, memory_order_relaxed);
+    for (int id = 1; id <= MM_TCACHE_THREADS; id++) {
+        void *inbox = atomic_load(&ids_taken[id]) ? NULL : CLOSED;
+        atomic_store_explicit(&inboxes[id], inbox, memory_order_relaxed);
+    }
+}
+
+/**
+ * Total size of the objects in the cache of the calling thread.
+ *
+ * @return bytes in cached objects
+ */
+size_t mm_tcache_bytes() {
+    return thread_cache()->bytes;
+}
+
+/**
+ * Round up a request size to the usable size guaranteed by its list.
+ *
+ * @param size requested payload size (at most MM_TCACHE_MAX)
+ * @return size to allocate for objects that serve this request from the cache
+ */
+size_t mm_tcache_class_size(size_t size) {
+    return (size + MM_ALIGNMENT - 1) / MM_ALIGNMENT * MM_ALIGNMENT;
+}
+
+/**
+ * Get the number of objects to allocate when the list for requests of `size`
+ * bytes is empty: it starts from 1 and doubles on each miss, up to
+ * MM_TCACHE_BATCH, so that sizes requested only a few times don't fill the
+ * cache with objects never used.
+ *
+ * @param size requested payload size (at most MM_TCACHE_MAX)
+ * @return number of objects to allocate (the first one is not cached)
+ */
+int mm_tcache_batch(size_t size) {
+    size_t cls = (size + MM_ALIGNMENT - 1) / MM_ALIGNMENT;
+    ThreadCache *tc = thread_cache();
+    int batch = (tc->batches[cls] == 0) ? 1 : tc->batches[cls];
+    tc->batches[cls] = (batch < MM_TCACHE_BATCH) ? 2 * batch : MM_TCACHE_BATCH;
+    return batch;
+}
+
+static void *pop(ThreadCache *tc, size_t cls, size_t size) {
+    void *ptr = tc->lists[cls];
+    if (ptr != NULL) {
+        tc->lists[cls] = *(void **)ptr;
+        tc->counts[cls]--;
+        tc->bytes -= size;
+    }
+    return ptr;
+}
+
+/**
+ * Take an object for a request of `size` bytes from the cache of the thread
+ * (the thread becomes its owner).
+ *
+ * @param size requested payload size
+ * @return address of an object with at least `size` usable bytes, or `NULL`
+ *         if the list is empty (or `size` is larger than MM_TCACHE_MAX)
+ */
+void *mm_tcache_pop(size_t size) {
+    size_t cls = (size + MM_ALIGNMENT - 1) / MM_ALIGNMENT;
+    if (cls >= MM_TCACHE_CLASSES)
+        return NULL;
+    void *ptr = pop(thread_cache(), cls, cls * MM_ALIGNMENT);
+    if (ptr != NULL && owners != NULL)
+        *owner_of(ptr) = thread_id;
+    return ptr;
+}
+
+/**
+ * Add a freed object to the cache of the thread.
+ *
+ * @param ptr address of the object (at least a pointer in size)
+ * @param usable_size usable size of the object
+ * @return 1 if the object was cached, 0 if its list is full (or over budget,
+ *         or it's too large)
+ */
+int mm_tcache_push(void *ptr, size_t usable_size) {
+    size_t cls = usable_size / MM_ALIGNMENT;
+    if (cls >= MM_TCACHE_CLASSES)
+        return 0;
+
+    ThreadCache *tc = thread_cache();
+    size_t size = cls * MM_ALIGNMENT;
+    if (tc->counts[cls] >= MM_TCACHE_COUNT || tc->bytes + size > MM_TCACHE_BUDGET)
+        return 0;
+
+    *(void **)ptr = tc->lists[cls];
+    tc->lists[cls] = ptr;
+    tc->counts[cls]++;
+    tc->bytes += size;
+    return 1;
+}
+
+/**
+ * Take an object from the list where an object of `usable_size` bytes would
+ * be cached (to drain a full list).
+ *
+ * @param usable_size usable size of an object
+ * @return address of an object, or `NULL` if the list is empty
+ */
+void *mm_tcache_pop_class(size_t usable_size) {
+    size_t cls = usable_size / MM_ALIGNMENT;
+    if (cls >= MM_TCACHE_CLASSES)
+        return NULL;
+    return pop(thread_cache(), cls, cls * MM_ALIGNMENT);
+}
+
+/**
+ * Take any object from the cache of the thread (to empty it).
+ *
+ * @return address of an object, or `NULL` if the cache is empty
+ */
+void *mm_tcache_pop_any() {
+    ThreadCache *tc = thread_cache();
+    if (tc->bytes == 0)
+        return NULL;
+    for (size_t cls = 1; cls < MM_TCACHE_CLASSES; cls++) {
+        if (tc->lists[cls] != NULL)
+            return pop(tc, cls, cls * MM_ALIGNMENT);
+    }
+    return NULL;
+}
+
+/**
+ * Record the calling thread as the owner of an object it allocated, so that
+ * other threads freeing it give it back to its inbox.
+ *
+ * @param ptr address of an object on the heap (of at most MM_TCACHE_MAX bytes)
+ */
+void mm_tcache_set_owner(void *ptr) {
+    if (owners != NULL)
+        *owner_of(ptr) = get_thread_id();
+}
+
+/**
+ * Forget the owner of an object given back to the heap (so that the next
+ * object at its address is freed by the thread that frees it, unless tagged).
+ *
+ * @param ptr address of an object on the heap
+ */
+void mm_tcache_clear_owner(void *ptr) {
+    if (owners != NULL)
+        *owner_of(ptr) = 0;
+}
+
+/**
+ * Give an object freed by the calling thread back to the inbox of the thread
+ * that owns it, if that's another thread (still running).
+ *
+ * @param ptr address of the object
+ * @param usable_size usable size of the object
+ * @return 1 if the object was pushed to the inbox of another thread, 0 if the
+ *         caller must free it (owned by the calling thread, by none, or by a
+ *         thread that has exited)
+ */
+int mm_tcache_remote_free(void *ptr, size_t usable_size) {
+    if (usable_size / MM_ALIGNMENT >= MM_TCACHE_CLASSES || owners == NULL)
+        return 0;
+    unsigned char owner = *owner_of(ptr);
+    if (owner == 0 || owner == get_thread_id() ||
+            !atomic_load_explicit(&ids_taken[owner], memory_order_relaxed))
+        return 0;
+
+    // the owner can exit meanwhile: then its inbox is closed
+    _Atomic(void *) *inbox = &inboxes[owner];
+    void *head = atomic_load_explicit(inbox, memory_order_relaxed);
+    do {
+        if (head == CLOSED)
+            return 0;
+        *(void **)ptr = head;
+    } while (!atomic_compare_exchange_weak_explicit(inbox, &head, ptr,
+                memory_order_release, memory_order_relaxed));
+    return 1;
+}
+
+/**
+ * Take all the objects in the inbox of the calling thread.
+ *
+ * @return the first object of the list (linked through their first word), or
+ *         `NULL` if the inbox is empty
+ */
+void *mm_tcache_take_inbox() {
+    _Atomic(void *) *inbox = &inboxes[thread_id];
+    if (thread_id == 0 || atomic_load_explicit(inbox, memory_order_relaxed) == NULL)
+        return NULL;
+    return atomic_exchange_explicit(inbox, NULL, memory_order_acquire);
+}
+
+/**
+ * Give back the id of the calling thread when it exits: its inbox is closed
+ * first, so that no object is pushed to it after the last ones are taken (the
+ * caller must free them, then empty its cache).
+ *
+ * @return the first object left in the inbox (linked through their first
+ *         word), or `NULL` if it was empty
+ */
+void *mm_tcache_exit() {
+    if (thread_id == 0)
+        return NULL;
+    void *inbox = atomic_exchange_explicit(&inboxes[thread_id], CLOSED, memory_order_acquire);
+    atomic_store(&ids_taken[thread_id], 0);
+    thread_id = 0;
+    return inbox;
+}
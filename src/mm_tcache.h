@@ -0,0 +1,44 @@
+#ifndef __MM_TCACHE_H__
+#define __MM_TCACHE_H__
+
+#include <mm.h>      // MM_ALIGNMENT
+#include <stddef.h>  // size_t
+
+/**
+ * Thread caches: each thread keeps LIFO lists of freed objects with a usable
+ * size of up to MM_TCACHE_MAX bytes, one list for each multiple of
+ * MM_ALIGNMENT, so that most requests of small objects don't need to lock the
+ * heap. Objects in a cache are still allocated for the rest of the allocator.
+ *
+ * A list holds at most MM_TCACHE_COUNT objects, and all the lists of a thread
+ * at most MM_TCACHE_BUDGET bytes; objects move from/to the heap in batches (of
+ * up to MM_TCACHE_BATCH).
+ *
+ * Objects taken from a cache are tagged with the id of the thread (up to
+ * MM_TCACHE_THREADS threads get one): when another thread frees them, they
+ * are pushed to the inbox of their owner without locking, and the owner takes
+ * them back in a batch on its next allocation. Once the owner has exited (or
+ * for untagged objects), the thread that frees an object keeps it.
+ */
+#define MM_TCACHE_MAX 512
+#define MM_TCACHE_CLASSES (MM_TCACHE_MAX / MM_ALIGNMENT + 1)
+#define MM_TCACHE_COUNT 16
+#define MM_TCACHE_BATCH 4
+#define MM_TCACHE_BUDGET (32 * 1024)
+#define MM_TCACHE_THREADS 255
+
+void mm_tcache_init();
+size_t mm_tcache_bytes();
+size_t mm_tcache_class_size(size_t size);
+int mm_tcache_batch(size_t size);
+void *mm_tcache_pop(size_t size);
+int mm_tcache_push(void *ptr, size_t usable_size);
+void *mm_tcache_pop_class(size_t usable_size);
+void *mm_tcache_pop_any();
+void mm_tcache_set_owner(void *ptr);
+void mm_tcache_clear_owner(void *ptr);
+int mm_tcache_remote_free(void *ptr, size_t usable_size);
+void *mm_tcache_take_inbox();
+void *mm_tcache_exit();
+
+#endif /* __MM_TCACHE_H__ */
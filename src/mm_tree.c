@@ -0,0 +1,337 @@
+#include <mm_tree.h>  // prototypes of functions implemented in this file
+#include <stddef.h>   // NULL
+
+BlockHeader *mm_tree_rootp;
+
+/**
+ * In addition to the block header with size/allocated bit, a free block in the
+ * tree has links to the headers of its left child, right child and parent,
+ * and the color of its node (MM_BLOCK_LINKS bytes in all).
+ */
+typedef struct {
+    BlockHeader header;
+    BlockLink left;
+    BlockLink right;
+    BlockLink parent;
+    int red;
+} TreeBlockHeader;
+
+/**
+ * Initializes to an empty tree.
+ */
+void mm_tree_init() {
+    mm_tree_rootp = NULL;
+}
+
+/**
+ * Find the header address of the left child of a block in the tree.
+ *
+ * @param bp address of a block header (it must be in the tree)
+ * @return address of the header of the left child (`NULL` if none)
+ */
+BlockHeader *mm_tree_left(BlockHeader *bp) {
+    return mm_block_from_link(((TreeBlockHeader *)bp)->left);
+}
+
+/**
+ * Find the header address of the right child of a block in the tree.
+ *
+ * @param bp address of a block header (it must be in the tree)
+ * @return address of the header of the right child (`NULL` if none)
+ */
+BlockHeader *mm_tree_right(BlockHeader *bp) {
+    return mm_block_from_link(((TreeBlockHeader *)bp)->right);
+}
+
+/**
+ * Find the header address of the parent of a block in the tree.
+ *
+ * @param bp address of a block header (it must be in the tree)
+ * @return address of the header of the parent (`NULL` for the root)
+ */
+BlockHeader *mm_tree_parent(BlockHeader *bp) {
+    return mm_block_from_link(((TreeBlockHeader *)bp)->parent);
+}
+
+/**
+ * Read the color of a node; missing children (`NULL`) are black.
+ *
+ * @param bp address of a block header in the tree, or `NULL`
+ * @return 1 if red, 0 if black
+ */
+int mm_tree_red(BlockHeader *bp) {
+    return bp != NULL && ((TreeBlockHeader *)bp)->red;
+}
+
+static void set_left(BlockHeader *bp, BlockHeader *left) {
+    ((TreeBlockHeader *)bp)->left = mm_block_link(left);
+}
+
+static void set_right(BlockHeader *bp, BlockHeader *right) {
+    ((TreeBlockHeader *)bp)->right = mm_block_link(right);
+}
+
+static void set_parent(BlockHeader *bp, BlockHeader *parent) {
+    ((TreeBlockHeader *)bp)->parent = mm_block_link(parent);
+}
+
+static void set_red(BlockHeader *bp, int red) {
+    ((TreeBlockHeader *)bp)->red = red;
+}
+
+/**
+ * Compare blocks by size, then by address.
+ *
+ * @return 1 if block `a` comes before block `b` in the tree
+ */
+static int tree_less(BlockHeader *a, BlockHeader *b) {
+    size_t size_a = mm_block_size(a);
+    size_t size_b = mm_block_size(b);
+    return size_a < size_b || (size_a == size_b && a < b);
+}
+
+/**
+ * Make `new_child` take the place of `old_child` below `parent` (or as root).
+ */
+static void replace_child(BlockHeader *parent, BlockHeader *old_child, BlockHeader *new_child) {
+    if (parent == NULL) {
+        mm_tree_rootp = new_child;
+    } else if (mm_tree_left(parent) == old_child) {
+        set_left(parent, new_child);
+    } else {
+        set_right(parent, new_child);
+    }
+}
+
+static void rotate_left(BlockHeader *x) {
+    BlockHeader *y = mm_tree_right(x);
+    set_right(x, mm_tree_left(y));
+    if (mm_tree_left(y) != NULL) {
+        set_parent(mm_tree_left(y), x);
+    }
+    set_parent(y, mm_tree_parent(x));
+    replace_child(mm_tree_parent(x), x, y);
+    set_left(y, x);
+    set_parent(x, y);
+}
+
+static void rotate_right(BlockHeader *x) {
+    BlockHeader *y = mm_tree_left(x);
+    set_left(x, mm_tree_right(y));
+    if (mm_tree_right(y) != NULL) {
+        set_parent(mm_tree_right(y), x);
+    }
+    set_parent(y, mm_tree_parent(x));
+    replace_child(mm_tree_parent(x), x, y);
+    set_right(y, x);
+    set_parent(x, y);
+}
+
+/**
+ * Restore the red-black properties after inserting the red node `z`.
+ */
+static void insert_fixup(BlockHeader *z) {
+    while (mm_tree_red(mm_tree_parent(z))) {
+        BlockHeader *p = mm_tree_parent(z);
+        BlockHeader *g = mm_tree_parent(p);  // exists, since the root is black
+        if (p == mm_tree_left(g)) {
+            BlockHeader *uncle = mm_tree_right(g);
+            if (mm_tree_red(uncle)) {
+                set_red(p, 0);
+                set_red(uncle, 0);
+                set_red(g, 1);
+                z = g;
+            } else {
+                if (z == mm_tree_right(p)) {
+                    z = p;
+                    rotate_left(z);
+                    p = mm_tree_parent(z);
+                }
+                set_red(p, 0);
+                set_red(g, 1);
+                rotate_right(g);
+            }
+        } else {
+            BlockHeader *uncle = mm_tree_left(g);
+            if (mm_tree_red(uncle)) {
+                set_red(p, 0);
+                set_red(uncle, 0);
+                set_red(g, 1);
+                z = g;
+            } else {
+                if (z == mm_tree_left(p)) {
+                    z = p;
+                    rotate_right(z);
+                    p = mm_tree_parent(z);
+                }
+                set_red(p, 0);
+                set_red(g, 1);
+                rotate_left(g);
+            }
+        }
+    }
+    set_red(mm_tree_rootp, 0);
+}
+
+/**
+ * Add a free block to the tree.
+ *
+ * @param bp address of the header of the block to add
+ */
+void mm_tree_insert(BlockHeader *bp) {
+    BlockHeader *parent = NULL;
+    BlockHeader *x = mm_tree_rootp;
+    while (x != NULL) {
+        parent = x;
+        x = tree_less(bp, x) ? mm_tree_left(x) : mm_tree_right(x);
+    }
+
+    set_left(bp, NULL);
+    set_right(bp, NULL);
+    set_parent(bp, parent);
+    set_red(bp, 1);
+    if (parent == NULL) {
+        mm_tree_rootp = bp;
+    } else if (tree_less(bp, parent)) {
+        set_left(parent, bp);
+    } else {
+        set_right(parent, bp);
+    }
+    insert_fixup(bp);
+}
+
+/**
+ * Restore the red-black properties after removing a black node, where `x`
+ * (possibly `NULL`) is the child of `parent` that carries an extra black.
+ */
+static void remove_fixup(BlockHeader *x, BlockHeader *parent) {
+    while (x != mm_tree_rootp && !mm_tree_red(x)) {
+        if (x == mm_tree_left(parent)) {
+            BlockHeader *w = mm_tree_right(parent);  // not NULL: black height > 0
+            if (mm_tree_red(w)) {
+                set_red(w, 0);
+                set_red(parent, 1);
+                rotate_left(parent);
+                w = mm_tree_right(parent);
+            }
+            if (!mm_tree_red(mm_tree_left(w)) && !mm_tree_red(mm_tree_right(w))) {
+                set_red(w, 1);
+                x = parent;
+                parent = mm_tree_parent(x);
+            } else {
+                if (!mm_tree_red(mm_tree_right(w))) {
+                    set_red(mm_tree_left(w), 0);
+                    set_red(w, 1);
+                    rotate_right(w);
+                    w = mm_tree_right(parent);
+                }
+                set_red(w, mm_tree_red(parent));
+                set_red(parent, 0);
+                set_red(mm_tree_right(w), 0);
+                rotate_left(parent);
+                x = mm_tree_rootp;
+            }
+        } else {
+            BlockHeader *w = mm_tree_left(parent);
+            if (mm_tree_red(w)) {
+                set_red(w, 0);
+                set_red(parent, 1);
+                rotate_right(parent);
+                w = mm_tree_left(parent);
+            }
+            if (!mm_tree_red(mm_tree_left(w)) && !mm_tree_red(mm_tree_right(w))) {
+                set_red(w, 1);
+                x = parent;
+                parent = mm_tree_parent(x);
+            } else {
+                if (!mm_tree_red(mm_tree_left(w))) {
+                    set_red(mm_tree_right(w), 0);
+                    set_red(w, 1);
+                    rotate_left(w);
+                    w = mm_tree_left(parent);
+                }
+                set_red(w, mm_tree_red(parent));
+                set_red(parent, 0);
+                set_red(mm_tree_left(w), 0);
+                rotate_right(parent);
+                x = mm_tree_rootp;
+            }
+        }
+    }
+    if (x != NULL) {
+        set_red(x, 0);
+    }
+}
+
+/**
+ * Remove a block from the tree.
+ *
+ * The block size must not have changed since the block was added.
+ *
+ * @param bp address of the header of the block to remove
+ */
+void mm_tree_remove(BlockHeader *bp) {
+    BlockHeader *x;
+    BlockHeader *x_parent;
+    int removed_red = mm_tree_red(bp);
+
+    if (mm_tree_left(bp) == NULL || mm_tree_right(bp) == NULL) {
+        // at most one child: it takes the place of bp
+        x = mm_tree_left(bp) != NULL ? mm_tree_left(bp) : mm_tree_right(bp);
+        x_parent = mm_tree_parent(bp);
+        replace_child(x_parent, bp, x);
+        if (x != NULL) {
+            set_parent(x, x_parent);
+        }
+    } else {
+        // two children: the successor y (leftmost on the right) replaces bp
+        BlockHeader *y = mm_tree_right(bp);
+        while (mm_tree_left(y) != NULL) {
+            y = mm_tree_left(y);
+        }
+        removed_red = mm_tree_red(y);
+        x = mm_tree_right(y);
+        if (mm_tree_parent(y) == bp) {
+            x_parent = y;
+        } else {
+            x_parent = mm_tree_parent(y);
+            replace_child(x_parent, y, x);
+            if (x != NULL) {
+                set_parent(x, x_parent);
+            }
+            set_right(y, mm_tree_right(bp));
+            set_parent(mm_tree_right(y), y);
+        }
+        replace_child(mm_tree_parent(bp), bp, y);
+        set_parent(y, mm_tree_parent(bp));
+        set_left(y, mm_tree_left(bp));
+        set_parent(mm_tree_left(y), y);
+        set_red(y, mm_tree_red(bp));
+    }
+
+    if (!removed_red) {
+        remove_fixup(x, x_parent);
+    }
+}
+
+/**
+ * Find the smallest free block with size greater or equal to `size` (and the
+ * lowest address among blocks of that size).
+ *
+ * @param size minimum size of the free block
+ * @return pointer to the header of a free block or `NULL` if free blocks in
+ *         the tree are all smaller than `size`
+ */
+BlockHeader *mm_tree_best_fit(size_t size) {
+    BlockHeader *best = NULL;
+    BlockHeader *x = mm_tree_rootp;
+    while (x != NULL) {
+        if (mm_block_size(x) >= size) {
+            best = x;
+            x = mm_tree_left(x);
+        } else {
+            x = mm_tree_right(x);
+        }
+    }
+    return best;
+}
@@ -0,0 +1,26 @@
+#ifndef __MM_TREE_H__
+#define __MM_TREE_H__
+
+#include <mm_block.h>  // BlockHeader
+
+/**
+ * Free blocks of at least MM_TREE_MIN_SIZE bytes are kept in a red-black tree
+ * ordered by (size, address) instead of the segregated free list.
+ */
+#define MM_TREE_MIN_SIZE 1024
+
+/**
+ * Pointer to the root of the tree (a block on the heap).
+ */
+extern BlockHeader *mm_tree_rootp;
+
+void mm_tree_init();
+void mm_tree_insert(BlockHeader *bp);
+void mm_tree_remove(BlockHeader *bp);
+BlockHeader *mm_tree_best_fit(size_t size);
+BlockHeader *mm_tree_left(BlockHeader *bp);
+BlockHeader *mm_tree_right(BlockHeader *bp);
+BlockHeader *mm_tree_parent(BlockHeader *bp);
+int mm_tree_red(BlockHeader *bp);
+
+#endif /* __MM_TREE_H__ */
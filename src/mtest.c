@@ -2,15 +2,20 @@
 
 #include "mm.h"
 #include "memlib.h"
+#include "trace.h"
+#include "counters.h"
 
 #include <stdio.h>   // printf, fprintf, sprintf, stderr, EOF, FILE
 #include <stdlib.h>  // exit, free, malloc, realloc, free, atoi
-#include <string.h>  // memset, strdup (needs _POSIX_C_SOURCE), strncmp
+#include <string.h>  // memset, strdup (needs _POSIX_C_SOURCE), strncmp, strerror
 #include <assert.h>  // assert
 #include <float.h>   // DBL_MAX
 #include <time.h>    // clock_gettime, CLOCK_MONOTONIC
 #include <getopt.h>  // getopt, optarg
 #include <math.h>    // fmin
+#include <pthread.h> // pthread_create, pthread_join
+#include <errno.h>   // errno
+#include <sys/resource.h>  // getrusage -- to count page faults
 
 #define MIN(a,b) (((a)<(b))?(a):(b))
 #define MAX(a,b) (((a)>(b))?(a):(b))
@@ -22,158 +27,208 @@ static void trace_error(int tracenum, int opnum, char *msg) {
     printf("ERROR [trace %d, line %d]: %s\n", tracenum, opnum+3, msg);  // 2 header lines
 }
 
-/* recorded list of allocated blocks */
+/* recorded payloads of allocated blocks: a treap ordered by address (a binary
+   search tree that is also a heap of random priorities, so that it's balanced
+   on average); since payloads don't overlap, a new payload can only overlap
+   the one starting last at or before its end */
 typedef struct BlockItem {
     char *lo;
     char *hi;
-    struct BlockItem *next;
+    unsigned int priority;
+    struct BlockItem *left;
+    struct BlockItem *right;
 } BlockItem;
 
+static unsigned int random_priority(void) {
+    static unsigned int state = 2463534242u;  // xorshift32
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+static BlockItem *find_block_before(BlockItem *p, char *addr) {
+    BlockItem *found = NULL;
+    while (p != NULL) {
+        if (p->lo <= addr) {
+            found = p;
+            p = p->right;
+        } else {
+            p = p->left;
+        }
+    }
+    return found;
+}
+
+static BlockItem *insert_block(BlockItem *p, BlockItem *item) {
+    if (p == NULL)
+        return item;
+
+    if (item->lo < p->lo) {
+        p->left = insert_block(p->left, item);
+        if (p->left->priority > p->priority) {  // rotate right
+            BlockItem *q = p->left;
+            p->left = q->right;
+            q->right = p;
+            return q;
+        }
+    } else {
+        p->right = insert_block(p->right, item);
+        if (p->right->priority > p->priority) {  // rotate left
+            BlockItem *q = p->right;
+            p->right = q->left;
+            q->left = p;
+            return q;
+        }
+    }
+    return p;
+}
+
+/* merge two treaps, with all addresses in `a` before those in `b` */
+static BlockItem *merge_blocks(BlockItem *a, BlockItem *b) {
+    if (a == NULL)
+        return b;
+    if (b == NULL)
+        return a;
+    if (a->priority > b->priority) {
+        a->right = merge_blocks(a->right, b);
+        return a;
+    }
+    b->left = merge_blocks(a, b->left);
+    return b;
+}
+
 static int add_block(BlockItem **blocks, char *lo, int size, int tracenum, int opnum) {
     char msg[1024];
 
-    if ((unsigned int)lo % 8 != 0) {
-        sprintf(msg, "Payload address (%p) not aligned to 8 bytes", lo);
+    if ((uintptr_t)lo % MM_ALIGNMENT != 0) {
+        sprintf(msg, "Payload address (%p) not aligned to %d bytes", lo, MM_ALIGNMENT);
         trace_error(tracenum, opnum, msg);
         return 0;
     }
 
     assert(size > 0);
     char *hi = lo + size - 1;
-    if ((lo < (char *)mem_heap_lo()) || (lo > (char *)mem_heap_hi()) ||
-        (hi < (char *)mem_heap_lo()) || (hi > (char *)mem_heap_hi())) {
-        sprintf(msg, "Payload (%p:%p) lies outside heap (%p:%p)", lo, hi, mem_heap_lo(), mem_heap_hi());
+    int in_heap = (mem_heap_lo() == NULL) || mem_in_heap(lo, hi);  // (no heap for libc)
+    if (!in_heap && !mem_mapped(lo, hi)) {
+        sprintf(msg, "Payload (%p:%p) lies outside heap (%p:%p) and mappings", lo, hi, mem_heap_lo(), mem_heap_hi());
         trace_error(tracenum, opnum, msg);
         return 0;
     }
 
-    for (BlockItem *p = *blocks;  p != NULL;  p = p->next) {
-        if ((lo >= p->lo && lo <= p-> hi) || (hi >= p->lo && hi <= p->hi)) {
-            sprintf(msg, "Payload (%p:%p) overlaps another payload (%p:%p)\n", lo, hi, p->lo, p->hi);
-            trace_error(tracenum, opnum, msg);
-            return 0;
-        }
+    BlockItem *p = find_block_before(*blocks, hi);
+    if (p != NULL && p->hi >= lo) {
+        sprintf(msg, "Payload (%p:%p) overlaps another payload (%p:%p)\n", lo, hi, p->lo, p->hi);
+        trace_error(tracenum, opnum, msg);
+        return 0;
     }
 
-    // add to head of block list
     BlockItem *newBlock = malloc(sizeof(BlockItem));
     if (newBlock == NULL) {
         perror("malloc error in add_block");
         exit(1);
     }
-    newBlock->next = *blocks;
     newBlock->lo = lo;
     newBlock->hi = hi;
-    *blocks = newBlock;
+    newBlock->priority = random_priority();
+    newBlock->left = NULL;
+    newBlock->right = NULL;
+    *blocks = insert_block(*blocks, newBlock);
     return 1;
 }
 
 static void remove_block(BlockItem **blocks, char *lo) {
-    BlockItem **prev_next_ptr = blocks;
-    for (BlockItem *p = *blocks;  p != NULL; p = p->next) {
+    BlockItem **parent_ptr = blocks;
+    for (BlockItem *p = *blocks;  p != NULL;  p = *parent_ptr) {
         if (p->lo == lo) {
-            *prev_next_ptr = p->next;
+            *parent_ptr = merge_blocks(p->left, p->right);
             free(p);
             return;
         }
-        prev_next_ptr = &(p->next);
+        parent_ptr = (lo < p->lo) ? &p->left : &p->right;
     }
 }
 
 static void free_blocks(BlockItem **blocks) {
     BlockItem *p = *blocks;
-    while (p != NULL) {
-        BlockItem *next = p->next;
+    if (p != NULL) {
+        free_blocks(&p->left);
+        free_blocks(&p->right);
         free(p);
-        p = next;
     }
     *blocks = NULL;
 }
 
-/* trace reading */
+/* fragmentation timeline: every `every` ops of the validation replay (and
+   after the last one), the live payload bytes and the free space on the heap
+   (from mm_get_stats), written as CSV, or as JSON if the file name ends with
+   ".json" */
 typedef struct {
-    enum {ALLOC, FREE, REALLOC} type;
-    int index;
-    int size;
-} TraceOp;
-
-typedef struct {
-    int num_ids;
-    int num_ops;
-    TraceOp *ops;
-    char **blocks;
-    int *block_sizes;
-} Trace;
-
-static void free_trace(Trace *trace) {
-    free(trace->ops);
-    free(trace->blocks);
-    free(trace->block_sizes);
-    free(trace);
-}
-
-static Trace *read_trace(char *filename) {
-    FILE *tracefile = fopen(filename, "r");
-    if (tracefile == NULL) {
-        char msg[1024];
-        sprintf(msg, "Could not open %s in read_trace", filename);
-        perror(msg);
+    FILE *file;
+    int every;
+    int json;
+    int samples;  // written for the current trace
+} Timeline;
+
+static Timeline *timeline_open(char *filename, int every) {
+    Timeline *timeline = malloc(sizeof(Timeline));
+    if (timeline == NULL || (timeline->file = fopen(filename, "w")) == NULL) {
+        perror("Could not open the timeline file");
         exit(1);
     }
-
-    Trace *trace = malloc(sizeof(Trace));
-    if (trace == NULL) {
-        perror("malloc 1 failed in read_trace");
-        exit(1);
+    size_t len = strlen(filename);
+    timeline->every = every;
+    timeline->json = len >= 5 && strcmp(filename + len - 5, ".json") == 0;
+    timeline->samples = -1;  // no trace yet
+    if (timeline->json) {
+        fprintf(timeline->file, "[");
+    } else {
+        fprintf(timeline->file, "trace,op,live_bytes,heap_bytes,free_bytes,free_blocks,largest_free,fragmentation\n");
     }
+    return timeline;
+}
 
-    fscanf(tracefile, "%d", &(trace->num_ids));
-    if ((trace->blocks = malloc(trace->num_ids * sizeof(char *))) == NULL) {
-        perror("malloc 2 failed in read_trace");
-        exit(1);
-    } else if ((trace->block_sizes = malloc(trace->num_ids * sizeof(int))) == NULL) {
-        perror("malloc 3 failed in read_trace");
-        exit(1);
+static void timeline_begin(Timeline *timeline, char *tracename) {
+    if (timeline->json) {
+        fprintf(timeline->file, "%s\n  {\"trace\": \"%s\", \"samples\": [",
+            (timeline->samples < 0) ? "" : ",", tracename);
     }
+    timeline->samples = 0;
+}
 
-    fscanf(tracefile, "%d", &(trace->num_ops));
-    if ((trace->ops = malloc(trace->num_ops * sizeof(TraceOp))) == NULL) {
-        perror("malloc 4 failed in read_trace");
-        exit(1);
+/**
+ * Write a sample after `op` ops with `live_bytes` bytes of payloads. The
+ * external fragmentation index is the part of the free bytes that is not in
+ * the largest free block (0 if all the free space is in one block).
+ */
+static void timeline_sample(Timeline *timeline, int tracenum, int op, int live_bytes) {
+    MMStats stats;
+    mm_get_stats(&stats);
+    double fragmentation = (stats.free_bytes == 0) ? 0.0 : 1.0 - (double)stats.largest_free / stats.free_bytes;
+    if (timeline->json) {
+        fprintf(timeline->file, "%s\n    {\"op\": %d, \"live_bytes\": %d, \"heap_bytes\": %zu, "
+            "\"free_bytes\": %zu, \"free_blocks\": %zu, \"largest_free\": %zu, \"fragmentation\": %.4f}",
+            (timeline->samples == 0) ? "" : ",", op, live_bytes, stats.heap_size,
+            stats.free_bytes, stats.free_blocks, stats.largest_free, fragmentation);
+    } else {
+        fprintf(timeline->file, "%d,%d,%d,%zu,%zu,%zu,%zu,%.4f\n", tracenum, op, live_bytes,
+            stats.heap_size, stats.free_bytes, stats.free_blocks, stats.largest_free, fragmentation);
     }
+    timeline->samples++;
+}
 
-    int op_index = 0;
-    int max_block_index = 0;
-    char op_type[1024];
-    while (fscanf(tracefile, "%s", op_type) != EOF) {
-        int block_index;
-        int block_size;
-        switch(op_type[0]) {
-            case 'a':
-            case 'r':
-                trace->ops[op_index].type = (op_type[0] == 'a') ? ALLOC : REALLOC;
-                fscanf(tracefile, "%u %u", &block_index, &block_size);
-                trace->ops[op_index].index = block_index;
-                trace->ops[op_index].size = block_size;
-                max_block_index = (block_index > max_block_index) ? block_index : max_block_index;
-                break;
-            case 'f':
-                trace->ops[op_index].type = FREE;
-                trace->ops[op_index].size = 0;
-                fscanf(tracefile, "%ud", &block_index);
-                trace->ops[op_index].index = block_index;
-                break;
-            default:
-                printf("Unknown op type (%s) in %s\n", op_type, filename);
-                exit(1);
-        }
-        op_index++;
+static void timeline_end(Timeline *timeline) {
+    if (timeline->json) {
+        fprintf(timeline->file, "\n  ]}");
     }
+}
 
-    assert(max_block_index == trace->num_ids - 1);
-    assert(trace->num_ops == op_index);
-    fclose(tracefile);
-    return trace;
+static void timeline_close(Timeline *timeline) {
+    if (timeline->json) {
+        fprintf(timeline->file, "\n]\n");
+    }
+    fclose(timeline->file);
+    free(timeline);
 }
 
 /* solution testing */
@@ -181,7 +236,8 @@ typedef void *(*malloc_f)(size_t size);
 typedef void *(*realloc_f)(void *ptr, size_t size);
 typedef void  (*free_f)(void *ptr);
 
-static int eval_valid(malloc_f test_malloc, realloc_f test_realloc, free_f test_free, Trace *trace, int tracenum) {
+static int eval_valid(malloc_f test_malloc, realloc_f test_realloc, free_f test_free, Trace *trace, int tracenum,
+        Timeline *timeline) {
 
     int max_total_size = 0;
     int total_size = 0;
@@ -224,7 +280,7 @@ static int eval_valid(malloc_f test_malloc, realloc_f test_realloc, free_f test_
                 int old_size = trace->block_sizes[index];
                 int preserved_size = MIN(old_size, size);
                 for (int j = 0; j < preserved_size; j++) {
-                    if (newp[j] != (index & 0xFF)) {
+                    if ((unsigned char)newp[j] != (index & 0xFF)) {
                         trace_error(tracenum, i, "mm_realloc did not preserve data from old block");
                         return 0;
                     }
@@ -251,13 +307,17 @@ static int eval_valid(malloc_f test_malloc, realloc_f test_realloc, free_f test_
                 printf("Nonexistent request type in eval_mm_valid\n");
                 exit(1);
         }
+
+        if (timeline != NULL && ((i + 1) % timeline->every == 0 || i + 1 == trace->num_ops)) {
+            timeline_sample(timeline, tracenum, i + 1, total_size);
+        }
     }
 
     free_blocks(&blocks);
     return max_total_size;
 }
 
-static void replay_trace(malloc_f test_malloc, realloc_f test_realloc,
+static int replay_trace(malloc_f test_malloc, realloc_f test_realloc,
         free_f test_free, Trace *trace) {
 
     for (int i = 0;  i < trace->num_ops;  i++) {
@@ -267,8 +327,7 @@ static void replay_trace(malloc_f test_malloc, realloc_f test_realloc,
                 int size = trace->ops[i].size;
                 char *p = test_malloc(size);
                 if (p == NULL) {
-                    printf("mm_malloc error in eval_mm_speed\n");
-                    exit(1);
+                    return 0;
                 }
                 trace->blocks[index] = p;
                 break;
@@ -280,8 +339,7 @@ static void replay_trace(malloc_f test_malloc, realloc_f test_realloc,
                 char *oldp = trace->blocks[index];
                 char *newp = test_realloc(oldp, newsize);
                 if (newp == NULL) {
-                    printf("test_realloc error in eval_mm_speed\n");
-                    exit(1);
+                    return 0;
                 }
                 trace->blocks[index] = newp;
                 break;
@@ -299,6 +357,7 @@ static void replay_trace(malloc_f test_malloc, realloc_f test_realloc,
                 exit(1);
         }
     }
+    return 1;
 }
 
 static double eval_speed(malloc_f test_malloc, realloc_f test_realloc,
@@ -309,7 +368,10 @@ static double eval_speed(malloc_f test_malloc, realloc_f test_realloc,
     for (int i = 0; i < repeat_min; i++) {
         clock_gettime(CLOCK_MONOTONIC, &t0);
         for (int j = 0; j < num_executions; j++) {
-            replay_trace(test_malloc, test_realloc, test_free, trace);
+            if (!replay_trace(test_malloc, test_realloc, test_free, trace)) {
+                printf("allocation error in eval_speed\n");
+                exit(1);
+            }
         }
         clock_gettime(CLOCK_MONOTONIC, &t1);
         double elapsed = (t1.tv_sec - t0.tv_sec)*1000.0 + (t1.tv_nsec - t0.tv_nsec)/1000000.0;
@@ -318,12 +380,247 @@ static double eval_speed(malloc_f test_malloc, realloc_f test_realloc,
    return min;
 }
 
+/* latency histograms: HDR-style buckets, exact below HIST_SUB nanoseconds,
+   then HIST_SUB buckets for each power of 2 (so, values are reported within
+   1/HIST_SUB of the exact latency) */
+#define HIST_SUB_BITS 4
+#define HIST_SUB (1 << HIST_SUB_BITS)
+#define HIST_BUCKETS ((64 - HIST_SUB_BITS + 1) * HIST_SUB)
+
+typedef struct {
+    long counts[HIST_BUCKETS];
+    long total;
+    unsigned long long max;
+} Histogram;
+
+static int hist_bucket(unsigned long long ns) {
+    if (ns < HIST_SUB) {
+        return ns;
+    }
+    int e = 63 - __builtin_clzll(ns);  // at least HIST_SUB_BITS
+    return (e - HIST_SUB_BITS + 1) * HIST_SUB + ((ns >> (e - HIST_SUB_BITS)) & (HIST_SUB - 1));
+}
+
+/* smallest latency counted by bucket `b` */
+static unsigned long long hist_lowest(int b) {
+    if (b < HIST_SUB) {
+        return b;
+    }
+    int e = b / HIST_SUB + HIST_SUB_BITS - 1;
+    return (unsigned long long)(HIST_SUB + b % HIST_SUB) << (e - HIST_SUB_BITS);
+}
+
+static void hist_add(Histogram *hist, unsigned long long ns) {
+    hist->counts[hist_bucket(ns)]++;
+    hist->total++;
+    hist->max = MAX(hist->max, ns);
+}
+
+/* latency below which a fraction `q` of the values fall */
+static unsigned long long hist_percentile(Histogram *hist, double q) {
+    long rank = (long)ceil(q * hist->total);
+    long seen = 0;
+    for (int b = 0; b < HIST_BUCKETS; b++) {
+        seen += hist->counts[b];
+        if (seen >= rank && seen > 0) {
+            return MIN(hist_lowest(b), hist->max);
+        }
+    }
+    return hist->max;
+}
+
+static inline unsigned long long now_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (unsigned long long)t.tv_sec * 1000000000ull + t.tv_nsec;
+}
+
+/* cost of reading the clock twice, subtracted from each latency */
+static unsigned long long clock_overhead(void) {
+    unsigned long long min = ~0ull;
+    for (int i = 0; i < 1000; i++) {
+        unsigned long long t0 = now_ns();
+        unsigned long long ns = now_ns() - t0;
+        min = MIN(min, ns);
+    }
+    return min;
+}
+
+/**
+ * Replay `trace` `num_executions` times, adding the latency of each call to
+ * the histogram of its type (indexed by ALLOC, FREE, REALLOC).
+ */
+static void eval_latency(malloc_f test_malloc, realloc_f test_realloc,
+        free_f test_free, Trace *trace, int num_executions, Histogram hists[3]) {
+    unsigned long long overhead = clock_overhead();
+    for (int j = 0; j < num_executions; j++) {
+        for (int i = 0;  i < trace->num_ops;  i++) {
+            int index = trace->ops[i].index;
+            unsigned long long t0 = now_ns();
+            switch (trace->ops[i].type) {
+                case ALLOC:
+                    trace->blocks[index] = test_malloc(trace->ops[i].size);
+                    break;
+                case REALLOC:
+                    trace->blocks[index] = test_realloc(trace->blocks[index], trace->ops[i].size);
+                    break;
+                default:
+                    test_free(trace->blocks[index]);
+                    break;
+            }
+            unsigned long long ns = now_ns() - t0;
+            if (trace->blocks[index] == NULL && trace->ops[i].type != FREE) {
+                printf("allocation error in eval_latency\n");
+                exit(1);
+            }
+            hist_add(&hists[trace->ops[i].type], (ns > overhead) ? ns - overhead : 0);
+        }
+    }
+}
+
+/* multi-threaded replay */
+typedef struct {
+    malloc_f test_malloc;
+    realloc_f test_realloc;
+    free_f test_free;
+    Trace trace;  // ops of the shared trace, blocks of this thread
+    int num_executions;
+} ReplayArgs;
+
+static void *replay_thread(void *arg) {
+    ReplayArgs *args = arg;
+    for (int j = 0; j < args->num_executions; j++) {
+        if (!replay_trace(args->test_malloc, args->test_realloc, args->test_free, &args->trace)) {
+            return arg;  // out of memory: the other blocks of the replay are leaked
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Replay `trace` `num_executions` times on each of `num_threads` threads at
+ * once (each one with its own blocks).
+ *
+ * @return elapsed time in milliseconds, or a negative value if some request
+ *         failed
+ */
+static double eval_threads(malloc_f test_malloc, realloc_f test_realloc,
+        free_f test_free, Trace *trace, int num_threads, int num_executions) {
+    pthread_t *threads = malloc(num_threads * sizeof(pthread_t));
+    ReplayArgs *args = malloc(num_threads * sizeof(ReplayArgs));
+    if (threads == NULL || args == NULL) {
+        perror("malloc failed in eval_threads");
+        exit(1);
+    }
+
+    for (int t = 0; t < num_threads; t++) {
+        args[t].test_malloc = test_malloc;
+        args[t].test_realloc = test_realloc;
+        args[t].test_free = test_free;
+        args[t].trace = *trace;
+        args[t].trace.blocks = malloc(trace->num_ids * sizeof(char *));
+        args[t].num_executions = num_executions;
+        if (args[t].trace.blocks == NULL) {
+            perror("malloc failed in eval_threads");
+            exit(1);
+        }
+    }
+
+    struct timespec t0;
+    struct timespec t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (int t = 0; t < num_threads; t++) {
+        if (pthread_create(&threads[t], NULL, replay_thread, &args[t]) != 0) {
+            perror("pthread_create failed in eval_threads");
+            exit(1);
+        }
+    }
+    int failed = 0;
+    for (int t = 0; t < num_threads; t++) {
+        void *result;
+        pthread_join(threads[t], &result);
+        failed |= (result != NULL);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    for (int t = 0; t < num_threads; t++) {
+        free(args[t].trace.blocks);
+    }
+    free(args);
+    free(threads);
+    if (failed) {
+        return -1.0;
+    }
+    return (t1.tv_sec - t0.tv_sec)*1000.0 + (t1.tv_nsec - t0.tv_nsec)/1000000.0;
+}
+
+/**
+ * Print the throughput of all the traces replayed by 1 to `max_threads`
+ * threads at once, and the speedup over a single thread.
+ */
+static void eval_scaling(char *name, malloc_f test_malloc, realloc_f test_realloc, free_f test_free,
+        char *traces[], int traces_len, int repeat_min, int max_threads) {
+
+    Trace **loaded = malloc(traces_len * sizeof(Trace *));
+    if (loaded == NULL) {
+        perror("malloc failed in eval_scaling");
+        exit(1);
+    }
+    for (int i = 0; i < traces_len; i++) {
+        loaded[i] = read_trace(traces[i]);
+        if (loaded[i] == NULL)
+            exit(1);
+    }
+
+    printf("Scaling of %s malloc:\n", name);
+    printf("%7s%10s%8s\n", "threads", "kops/s", "speedup");
+    double single_tput = 0.0;
+    for (int num_threads = 1; num_threads <= max_threads; num_threads++) {
+        double total_ops = 0.0;
+        double total_ms = 0.0;
+        for (int i = 0; i < traces_len && total_ms >= 0.0; i++) {
+            double min = DBL_MAX;
+            for (int r = 0; r < repeat_min && min >= 0.0; r++) {
+                if (strncmp(name, "mm", 2) == 0) {
+                    mem_reset_brk();
+                    if (mm_init() < 0) {
+                        printf("mm_init failed in eval_scaling\n");
+                        exit(1);
+                    }
+                }
+                double ms = eval_threads(test_malloc, test_realloc, test_free, loaded[i], num_threads, 10);
+                min = (ms < 0.0) ? ms : fmin(min, ms);
+            }
+            total_ops += (double)loaded[i]->num_ops * num_threads * 10;
+            total_ms = (min < 0.0) ? min : total_ms + min;
+        }
+        if (total_ms < 0.0) {
+            // the heap can't hold the blocks of all the threads
+            printf("%7d%10s%8s\n", num_threads, "-", "-");
+            continue;
+        }
+        double tput = total_ops / total_ms;
+        if (num_threads == 1) {
+            single_tput = tput;
+        }
+        printf("%7d%10.0f%8.2f\n", num_threads, tput, tput / single_tput);
+    }
+    printf("\n");
+
+    for (int i = 0; i < traces_len; i++) {
+        free_trace(loaded[i]);
+    }
+    free(loaded);
+}
+
 /* output printing */
 typedef struct {
     int valid;
     double util;
     double ops;
     double ms;
+    long faults;
+    double counters[COUNTERS_LEN];  // per op (-1 if not available)
 } TraceStats;
 
 typedef struct {
@@ -333,32 +630,119 @@ typedef struct {
     double total_ops;
     double total_ms;
     double mean_tput;
+    long total_faults;
+    int latency;              // whether the histograms were measured
+    Histogram latencies[3];   // of all traces, by type of request
+    int counters;             // whether the hardware counters were read
 } Stats;
 
+/* page faults (minor and major) of the process so far */
+static long page_faults(void) {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_minflt + usage.ru_majflt;
+}
+
+static void print_counter_row(double values[COUNTERS_LEN]) {
+    for (int c = 0; c < COUNTERS_LEN; c++) {
+        if (values[c] < 0.0) {
+            printf("%10s", "-");
+        } else {
+            printf("%10.1f", values[c]);
+        }
+        if (c == COUNTER_INSTRUCTIONS) {
+            if (values[COUNTER_CYCLES] > 0.0 && values[COUNTER_INSTRUCTIONS] >= 0.0) {
+                printf("%6.2f", values[COUNTER_INSTRUCTIONS] / values[COUNTER_CYCLES]);
+            } else {
+                printf("%6s", "-");
+            }
+        }
+    }
+    printf("\n");
+}
+
+static void print_counters(char *name, Stats *stats) {
+    printf("Counters of %s malloc (per op):\n", name);
+    printf("%5s", "trace");
+    for (int c = 0; c < COUNTERS_LEN; c++) {
+        printf("%10s", counter_names[c]);
+        if (c == COUNTER_INSTRUCTIONS) {
+            printf("%6s", "IPC");
+        }
+    }
+    printf("\n");
+
+    // the total is the mean of the valid traces, weighted by their ops
+    double total[COUNTERS_LEN] = {0};
+    double total_ops = 0.0;
+    for (int i = 0; i < stats->num_traces; i++) {
+        TraceStats *ts = &stats->traces[i];
+        if (ts->valid) {
+            printf("%2d   ", i);
+            print_counter_row(ts->counters);
+            for (int c = 0; c < COUNTERS_LEN; c++) {
+                total[c] = (total[c] < 0.0 || ts->counters[c] < 0.0) ? -1.0 : total[c] + ts->counters[c] * ts->ops;
+            }
+            total_ops += ts->ops;
+        }
+    }
+    for (int c = 0; c < COUNTERS_LEN; c++) {
+        if (total[c] >= 0.0) {
+            total[c] /= total_ops;
+        }
+    }
+    printf("%5s", "Total");
+    print_counter_row(total);
+    printf("\n");
+}
+
 static void print_results(char* name, Stats *stats) {
     printf("Results for %s malloc:\n", name);
-    printf("%5s%7s %5s%8s%10s%8s\n", "trace", " valid", "util", "ops", "ms", "kops/s");
+    printf("%5s%7s %5s%8s%10s%8s%8s\n", "trace", " valid", "util", "ops", "ms", "kops/s", "faults");
     for (int i = 0; i < stats->num_traces; i++) {
         if (stats->traces[i].valid) {
-            printf("%2d%10s%5.0f%%%8.0f%10.2f%8.0f\n",    i, "yes",
+            printf("%2d%10s%5.0f%%%8.0f%10.2f%8.0f%8ld\n",    i, "yes",
                 stats->traces[i].util*100.0,
                 stats->traces[i].ops,  stats->traces[i].ms,
-                stats->traces[i].ops / stats->traces[i].ms);
+                stats->traces[i].ops / stats->traces[i].ms,
+                stats->traces[i].faults);
         } else {
-            printf("%2d%10s%6s%8s%10s%8s\n", i, "no", "-", "-", "-", "-");
+            printf("%2d%10s%6s%8s%10s%8s%8s\n", i, "no", "-", "-", "-", "-", "-");
         }
     }
     if (errors == 0) {
-        printf("%12s%5.0f%%%8.0f%10.2f%8.0f\n", "Total       ",
-            stats->mean_util*100.0, stats->total_ops, stats->total_ms, stats->mean_tput);
+        printf("%12s%5.0f%%%8.0f%10.2f%8.0f%8ld\n", "Total       ",
+            stats->mean_util*100.0, stats->total_ops, stats->total_ms, stats->mean_tput,
+            stats->total_faults);
     } else {
-        printf("%12s%6s%8s%10s%8s\n", "Total       ", "-", "-", "-", "-");
+        printf("%12s%6s%8s%10s%8s%8s\n", "Total       ", "-", "-", "-", "-", "-");
     }
     printf("\n");
+
+    if (stats->counters && errors == 0) {
+        print_counters(name, stats);
+    }
+
+    if (stats->latency && errors == 0) {
+        char *ops[] = { [ALLOC] = "malloc", [FREE] = "free", [REALLOC] = "realloc" };
+        int order[] = { ALLOC, REALLOC, FREE };
+        printf("Latency of %s malloc (ns):\n", name);
+        printf("%-8s%10s%8s%8s%8s%8s%10s\n", "op", "count", "p50", "p90", "p99", "p99.9", "max");
+        for (int k = 0; k < 3; k++) {
+            Histogram *hist = &stats->latencies[order[k]];
+            if (hist->total == 0) {
+                continue;
+            }
+            printf("%-8s%10ld%8llu%8llu%8llu%8llu%10llu\n", ops[order[k]], hist->total,
+                hist_percentile(hist, 0.5), hist_percentile(hist, 0.9),
+                hist_percentile(hist, 0.99), hist_percentile(hist, 0.999), hist->max);
+        }
+        printf("\n");
+    }
 }
 
 static Stats *eval(char *name, malloc_f test_malloc, realloc_f test_realloc, free_f test_free,
-        char *traces[], int traces_len, int repeat_min) {
+        char *traces[], int traces_len, int repeat_min, int latency, int counters, Timeline *timeline) {
 
     Stats *stats = calloc(1, sizeof(Stats));
     if (stats == NULL) {
@@ -376,6 +760,8 @@ static Stats *eval(char *name, malloc_f test_malloc, realloc_f test_realloc, fre
     stats->total_ops = 0.0;
     stats->total_ms = 0.0;
     stats->num_traces = traces_len;
+    stats->latency = latency;
+    stats->counters = counters;
     for (int i = 0; i < traces_len; i++) {
         if (strncmp(name, "mm", 2) == 0) {
             if (i == 0) {
@@ -390,15 +776,27 @@ static Stats *eval(char *name, malloc_f test_malloc, realloc_f test_realloc, fre
         }
 
         Trace *trace = read_trace(traces[i]);
+        if (trace == NULL) {
+            trace_error(i, 0, "read_trace failed.");
+            stats->traces[i].valid = 0;
+            continue;
+        }
         stats->traces[i].ops = trace->num_ops;
         stats->total_ops += stats->traces[i].ops;
+        long faults = page_faults();
 
-        int max_total_size = eval_valid(test_malloc, test_realloc, test_free, trace, i);
+        if (timeline != NULL) {
+            timeline_begin(timeline, traces[i]);
+        }
+        int max_total_size = eval_valid(test_malloc, test_realloc, test_free, trace, i, timeline);
+        if (timeline != NULL) {
+            timeline_end(timeline);
+        }
         stats->traces[i].valid = max_total_size > 0;
 
         if (stats->traces[i].valid) {
             if (strncmp(name, "mm", 2) == 0) {
-                stats->traces[i].util = ((double)max_total_size / mem_heapsize());
+                stats->traces[i].util = ((double)max_total_size / mem_peak_heapsize());
                 stats->mean_util += stats->traces[i].util;
                 mem_reset_brk();
                 if (mm_init() < 0) {
@@ -406,9 +804,21 @@ static Stats *eval(char *name, malloc_f test_malloc, realloc_f test_realloc, fre
                     exit(1);
                 }
             }
+            counters_start();
             stats->traces[i].ms = eval_speed(test_malloc, test_realloc, test_free, trace, repeat_min, 10);
             stats->total_ms += stats->traces[i].ms;
+            counters_stop(stats->traces[i].counters);
+            for (int c = 0; c < COUNTERS_LEN; c++) {
+                if (stats->traces[i].counters[c] >= 0.0) {
+                    stats->traces[i].counters[c] /= stats->traces[i].ops * repeat_min * 10;
+                }
+            }
+            if (latency) {
+                eval_latency(test_malloc, test_realloc, test_free, trace, 10, stats->latencies);
+            }
         }
+        stats->traces[i].faults = page_faults() - faults;
+        stats->total_faults += stats->traces[i].faults;
 
         free_trace(trace);
     }
@@ -420,10 +830,17 @@ static Stats *eval(char *name, malloc_f test_malloc, realloc_f test_realloc, fre
 }
 
 static void usage(void) {
-    fprintf(stderr, "Usage: mtest [-h] [-r <reps>] [-f <file>]\nwhere\n");
+    fprintf(stderr, "Usage: mtest [-h] [-r <reps>] [-f <file>] [-p <threads>] [-l] [-c] [-s <ops> [-o <file>]] [-H] [-F]\nwhere\n");
     fprintf(stderr, "-h         Print program usage.\n");
     fprintf(stderr, "-r <reps>  Repeat measurements <reps> times. (default: 3)\n");
-    fprintf(stderr, "-t <trace> Use only <trace> as the trace file.\n");
+    fprintf(stderr, "-f <file>  Use only <file> as the trace file (text, or binary from trace2bin).\n");
+    fprintf(stderr, "-p <threads> Also replay the traces on 1 to <threads> threads at once.\n");
+    fprintf(stderr, "-l         Also report the latency of each type of request (percentiles).\n");
+    fprintf(stderr, "-c         Also report hardware counters per request (perf_event_open).\n");
+    fprintf(stderr, "-s <ops>   Sample the fragmentation of the heap every <ops> ops (of mm).\n");
+    fprintf(stderr, "-o <file>  Write the samples to <file>, as CSV or JSON (.json). (default: frag.csv)\n");
+    fprintf(stderr, "-H         Use transparent huge pages for the heap.\n");
+    fprintf(stderr, "-F         Pre-fault the pages of the heap when committed.\n");
 }
 
 int main(int argc, char **argv) {
@@ -443,8 +860,14 @@ int main(int argc, char **argv) {
         "./traces/realloc2-bal.rep"
     };
 
+    int max_threads = 0;
+    int mem_options = 0;
+    int latency = 0;
+    int counters = 0;
+    int sample_every = 0;
+    char *timeline_file = NULL;
     char c;
-    while ((c = getopt(argc, argv, "f:r:h")) != EOF) {
+    while ((c = getopt(argc, argv, "f:r:p:lcs:o:HFh")) != EOF) {
         switch (c) {
             case 'f':
                 traces[0] = strdup(optarg);
@@ -453,6 +876,27 @@ int main(int argc, char **argv) {
             case 'r':
                 repeat_min = atoi(optarg);
                 break;
+            case 'p':
+                max_threads = atoi(optarg);
+                break;
+            case 'l':
+                latency = 1;
+                break;
+            case 'c':
+                counters = 1;
+                break;
+            case 's':
+                sample_every = atoi(optarg);
+                break;
+            case 'o':
+                timeline_file = strdup(optarg);
+                break;
+            case 'H':
+                mem_options |= MEM_HUGE_PAGES;
+                break;
+            case 'F':
+                mem_options |= MEM_PREFAULT;
+                break;
             case 'h':
                 usage();
                 exit(0);
@@ -462,10 +906,25 @@ int main(int argc, char **argv) {
         }
     }
 
+    // the timeline file is only written when sampling
+    if (timeline_file != NULL && sample_every <= 0) {
+        usage();
+        exit(1);
+    }
+
+    mem_set_options(mem_options);
+    if (counters && counters_open() == 0) {
+        printf("Hardware counters not available (perf_event_open: %s)\n\n", strerror(errno));
+        counters = 0;
+    }
     errors = 0;
-    Stats *libc_stats = eval("libc", malloc, realloc, free, traces, traces_len, repeat_min);
+    Stats *libc_stats = eval("libc", malloc, realloc, free, traces, traces_len, repeat_min, latency, counters, NULL);
     errors = 0;
-    Stats *mm_stats = eval("mm", mm_malloc, mm_realloc, mm_free, traces, traces_len, repeat_min);
+    Timeline *timeline = (sample_every > 0) ? timeline_open(timeline_file != NULL ? timeline_file : "frag.csv", sample_every) : NULL;
+    Stats *mm_stats = eval("mm", mm_malloc, mm_realloc, mm_free, traces, traces_len, repeat_min, latency, counters, timeline);
+    if (timeline != NULL) {
+        timeline_close(timeline);
+    }
 
     if (errors != 0) {
         printf("Terminated with %d errors\n", errors);
@@ -476,6 +935,12 @@ int main(int argc, char **argv) {
         printf("PERFORMANCE INDEX: %.0f (util) + %.0f (thru) = %.0f/100\n", p1*100, p2*100, (p1 + p2)*100.0);
     }
 
+    if (max_threads > 0 && errors == 0) {
+        eval_scaling("libc", malloc, realloc, free, traces, traces_len, repeat_min, max_threads);
+        eval_scaling("mm", mm_malloc, mm_realloc, mm_free, traces, traces_len, repeat_min, max_threads);
+    }
+
+    counters_close();
     free(libc_stats);
     free(mm_stats);
     exit(0);
@@ -0,0 +1,194 @@
+#define _POSIX_C_SOURCE 200809L  // fileno
+
+#include "trace.h"
+
+#include <stdio.h>     // printf, fopen, fread, fwrite, fscanf, perror
+#include <stdlib.h>    // malloc, free, exit
+#include <string.h>    // memcmp, memcpy
+#include <assert.h>    // assert
+#include <sys/mman.h>  // mmap, posix_madvise, munmap
+#include <sys/stat.h>  // fstat
+
+static Trace *new_trace(int num_ids) {
+    Trace *trace = malloc(sizeof(Trace));
+    if (trace == NULL) {
+        perror("malloc 1 failed in read_trace");
+        exit(1);
+    }
+
+    trace->num_ids = num_ids;
+    trace->mapping = NULL;
+    trace->mapping_size = 0;
+    if ((trace->blocks = malloc(trace->num_ids * sizeof(char *))) == NULL) {
+        perror("malloc 2 failed in read_trace");
+        exit(1);
+    } else if ((trace->block_sizes = malloc(trace->num_ids * sizeof(int))) == NULL) {
+        perror("malloc 3 failed in read_trace");
+        exit(1);
+    }
+    return trace;
+}
+
+/**
+ * Check that all the ops of a trace are valid (so that they can be replayed
+ * without bound checks).
+ *
+ * @return index of the first invalid op, or -1 if all of them are valid
+ */
+static int check_ops(TraceOp *ops, int num_ops, int num_ids) {
+    for (int i = 0; i < num_ops; i++) {
+        if (ops[i].type != ALLOC && ops[i].type != FREE && ops[i].type != REALLOC)
+            return i;
+        if (ops[i].index < 0 || ops[i].index >= num_ids || ops[i].size < 0)
+            return i;
+    }
+    return -1;
+}
+
+/**
+ * Map a binary trace in memory: its ops are replayed in place, without
+ * parsing or copying them.
+ *
+ * @return the trace, or `NULL` if the file is truncated or corrupt
+ */
+static Trace *map_trace(FILE *tracefile, char *filename) {
+    struct stat st;
+    if (fstat(fileno(tracefile), &st) != 0 || (size_t)st.st_size < sizeof(TraceHeader)) {
+        printf("Truncated binary trace %s\n", filename);
+        return NULL;
+    }
+
+    void *mapping = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fileno(tracefile), 0);
+    if (mapping == MAP_FAILED) {
+        char msg[1024];
+        sprintf(msg, "Could not map %s in read_trace", filename);
+        perror(msg);
+        exit(1);
+    }
+    posix_madvise(mapping, st.st_size, POSIX_MADV_SEQUENTIAL);
+
+    TraceHeader header;
+    memcpy(&header, mapping, sizeof(header));
+    if (header.num_ids < 0 || header.num_ops < 0 ||
+            (size_t)st.st_size != sizeof(TraceHeader) + (size_t)header.num_ops * sizeof(TraceOp)) {
+        printf("Wrong size of binary trace %s\n", filename);
+        munmap(mapping, st.st_size);
+        return NULL;
+    }
+
+    TraceOp *ops = (TraceOp *)((char *)mapping + sizeof(TraceHeader));
+    int wrong = check_ops(ops, header.num_ops, header.num_ids);
+    if (wrong >= 0) {
+        printf("Wrong op %d of binary trace %s\n", wrong, filename);
+        munmap(mapping, st.st_size);
+        return NULL;
+    }
+
+    Trace *trace = new_trace(header.num_ids);
+    trace->num_ops = header.num_ops;
+    trace->ops = ops;
+    trace->mapping = mapping;
+    trace->mapping_size = st.st_size;
+    return trace;
+}
+
+/**
+ * Parse a text trace (.rep): the number of ids and of ops, then one op for
+ * each line ("a <id> <size>", "r <id> <size>" or "f <id>").
+ */
+static Trace *parse_trace(FILE *tracefile, char *filename) {
+    int num_ids;
+    fscanf(tracefile, "%d", &num_ids);
+    Trace *trace = new_trace(num_ids);
+
+    fscanf(tracefile, "%d", &(trace->num_ops));
+    if ((trace->ops = malloc(trace->num_ops * sizeof(TraceOp))) == NULL) {
+        perror("malloc 4 failed in read_trace");
+        exit(1);
+    }
+
+    int op_index = 0;
+    int max_block_index = 0;
+    char op_type[1024];
+    while (fscanf(tracefile, "%s", op_type) != EOF) {
+        int block_index;
+        int block_size;
+        switch(op_type[0]) {
+            case 'a':
+            case 'r':
+                trace->ops[op_index].type = (op_type[0] == 'a') ? ALLOC : REALLOC;
+                fscanf(tracefile, "%u %u", &block_index, &block_size);
+                trace->ops[op_index].index = block_index;
+                trace->ops[op_index].size = block_size;
+                max_block_index = (block_index > max_block_index) ? block_index : max_block_index;
+                break;
+            case 'f':
+                trace->ops[op_index].type = FREE;
+                trace->ops[op_index].size = 0;
+                fscanf(tracefile, "%ud", &block_index);
+                trace->ops[op_index].index = block_index;
+                break;
+            default:
+                printf("Unknown op type (%s) in %s\n", op_type, filename);
+                exit(1);
+        }
+        op_index++;
+    }
+
+    assert(max_block_index == trace->num_ids - 1);
+    assert(trace->num_ops == op_index);
+    return trace;
+}
+
+/**
+ * Read a trace file, either binary (starting with TRACE_MAGIC) or text.
+ *
+ * @return the trace, or `NULL` if it's a binary trace that is not valid
+ */
+Trace *read_trace(char *filename) {
+    FILE *tracefile = fopen(filename, "r");
+    if (tracefile == NULL) {
+        char msg[1024];
+        sprintf(msg, "Could not open %s in read_trace", filename);
+        perror(msg);
+        exit(1);
+    }
+
+    char magic[sizeof(TRACE_MAGIC) - 1];
+    int binary = fread(magic, 1, sizeof(magic), tracefile) == sizeof(magic) &&
+                 memcmp(magic, TRACE_MAGIC, sizeof(magic)) == 0;
+    rewind(tracefile);
+
+    Trace *trace = binary ? map_trace(tracefile, filename) : parse_trace(tracefile, filename);
+    fclose(tracefile);  // (the mapping stays valid)
+    return trace;
+}
+
+/**
+ * Write a trace in binary format.
+ *
+ * @return 0, or -1 if the file can't be written
+ */
+int write_trace(Trace *trace, char *filename) {
+    FILE *tracefile = fopen(filename, "wb");
+    if (tracefile == NULL)
+        return -1;
+
+    TraceHeader header;
+    memcpy(header.magic, TRACE_MAGIC, sizeof(header.magic));
+    header.num_ids = trace->num_ids;
+    header.num_ops = trace->num_ops;
+    int written = fwrite(&header, sizeof(header), 1, tracefile) == 1 &&
+                  fwrite(trace->ops, sizeof(TraceOp), trace->num_ops, tracefile) == (size_t)trace->num_ops;
+    return (fclose(tracefile) == 0 && written) ? 0 : -1;
+}
+
+void free_trace(Trace *trace) {
+    if (trace->mapping != NULL)
+        munmap(trace->mapping, trace->mapping_size);
+    else
+        free(trace->ops);
+    free(trace->blocks);
+    free(trace->block_sizes);
+    free(trace);
+}
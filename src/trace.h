@@ -0,0 +1,39 @@
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+#include <stddef.h>  // size_t
+#include <stdint.h>  // int32_t
+
+/* requests of a trace, with fixed-width fields: binary traces store them as
+   they are in memory (in native byte order), after a TraceHeader */
+enum {ALLOC, FREE, REALLOC};
+
+typedef struct {
+    int32_t type;   /* ALLOC, FREE or REALLOC */
+    int32_t index;  /* id of the block */
+    int32_t size;   /* 0 for FREE */
+} TraceOp;
+
+#define TRACE_MAGIC "MTRACE1\n"
+
+typedef struct {
+    char magic[8];  /* TRACE_MAGIC */
+    int32_t num_ids;
+    int32_t num_ops;
+} TraceHeader;
+
+typedef struct {
+    int num_ids;
+    int num_ops;
+    TraceOp *ops;         /* inside `mapping` for binary traces */
+    char **blocks;
+    int *block_sizes;
+    void *mapping;        /* binary trace file mapped in memory, or NULL */
+    size_t mapping_size;
+} Trace;
+
+Trace *read_trace(char *filename);
+int    write_trace(Trace *trace, char *filename);
+void   free_trace(Trace *trace);
+
+#endif /* __TRACE_H__ */
@@ -0,0 +1,22 @@
+#include "trace.h"
+
+#include <stdio.h>   // printf, fprintf, perror, stderr
+
+/* convert a text trace (.rep) to the binary format that mtest maps in memory */
+int main(int argc, char **argv) {
+    if (argc != 3) {
+        fprintf(stderr, "Usage: trace2bin <trace.rep> <trace.bin>\n");
+        return 1;
+    }
+
+    Trace *trace = read_trace(argv[1]);
+    if (trace == NULL)
+        return 1;
+    if (write_trace(trace, argv[2]) != 0) {
+        perror(argv[2]);
+        return 1;
+    }
+    printf("%s: %d ids, %d ops\n", argv[2], trace->num_ids, trace->num_ops);
+    free_trace(trace);
+    return 0;
+}
@@ -1,17 +1,24 @@
+#define _GNU_SOURCE  // mincore
+
 #include "unity.h"
 #include "memlib.h"
 
+// built with and without MM_HEAP_MAP (see the Makefile)
 #include "mm.c"
-#include <stdlib.h>
+
+#include <sys/mman.h>  // mincore
 
 static BlockHeader *new_block(int size) {
-    // NOTE: here we are allocating blocks with malloc, but
-    // mm.c should allocate them on the heap that you're managing
-    return malloc(size);
+    // NOTE: here we are taking blocks directly from the heap, but
+    // mm.c should allocate them as blocks on the heap that you're managing
+    return (BlockHeader *)mem_sbrk(size);
 }
 
 void setUp(void) {
-
+    // start from an empty heap (links are offsets from heap_blocks, so blocks
+    // created by new_block() must come after it)
+    mem_reset_brk();
+    mm_init();
 }
 
 void tearDown(void) {
@@ -19,16 +26,19 @@ void tearDown(void) {
 }
 
 void test_free_coalesce_alloc_alloc(void) {
-    BlockHeader *bp1 = new_block(16 + 16 + 16);
+    BlockHeader *bp1 = new_block(16 + 16 + 16 + 4);
     mm_block_set_header(bp1, 16, 1);
+    mm_block_set_prev_allocated(bp1, 1);
     mm_block_set_footer(bp1, 16, 1);
     BlockHeader *bp2 = mm_block_next(bp1);
     TEST_ASSERT(bp2 != NULL);
     mm_block_set_header(bp2, 16, 0);
+    mm_block_set_prev_allocated(bp2, 1);
     mm_block_set_footer(bp2, 16, 0);
     BlockHeader *bp3 = mm_block_next(bp2);
     TEST_ASSERT(bp3 != NULL);
     mm_block_set_header(bp3, 16, 1);
+    mm_block_set_prev_allocated(bp3, 0);
     mm_block_set_footer(bp3, 16, 1);
 
     mm_list_init();
@@ -36,8 +46,9 @@ void test_free_coalesce_alloc_alloc(void) {
     // must do no coalescing
     BlockHeader *coalesced = free_coalesce(bp2);
     TEST_ASSERT(coalesced == bp2);
-    TEST_ASSERT(mm_list_headp == bp2);
-    TEST_ASSERT(mm_list_tailp == bp2);
+    TEST_ASSERT(mm_block_prev_allocated(bp3) == 0);
+    TEST_ASSERT(mm_list_headp[mm_list_class(16)] == bp2);
+    TEST_ASSERT(mm_list_tailp[mm_list_class(16)] == bp2);
     TEST_ASSERT(mm_block_size(bp1) == 16);
     TEST_ASSERT(mm_block_allocated(bp1) == 1);
     TEST_ASSERT(mm_block_size(bp1+3) == 16);
@@ -53,18 +64,21 @@ void test_free_coalesce_alloc_alloc(void) {
 }
 
 void test_free_coalesce_alloc_free(void) {
-    BlockHeader *bp1 = new_block(16 + 16 + 16);
+    BlockHeader *bp1 = new_block(16 + 16 + 16 + 4);
     mm_block_set_header(bp1, 16, 1);
+    mm_block_set_prev_allocated(bp1, 1);
     mm_block_set_footer(bp1, 16, 1);
     *(bp1+1) = 0x01010101;  // payload of 8 bytes
     *(bp1+2) = 0x01010101;
     BlockHeader *bp2 = mm_block_next(bp1);
     TEST_ASSERT(bp2 != NULL);
     mm_block_set_header(bp2, 16, 0);
+    mm_block_set_prev_allocated(bp2, 1);
     mm_block_set_footer(bp2, 16, 0);
     BlockHeader *bp3 = mm_block_next(bp2);
     TEST_ASSERT(bp3 != NULL);
     mm_block_set_header(bp3, 16, 0);
+    mm_block_set_prev_allocated(bp3, 0);
     mm_block_set_footer(bp3, 16, 0);
 
     mm_list_init();
@@ -73,8 +87,8 @@ void test_free_coalesce_alloc_free(void) {
     // must coalesce bp2 and bp3, no change to bp1
     BlockHeader *coalesced = free_coalesce(bp2);
     TEST_ASSERT(coalesced == bp2);
-    TEST_ASSERT(mm_list_headp == bp2);
-    TEST_ASSERT(mm_list_tailp == bp2);
+    TEST_ASSERT(mm_list_headp[mm_list_class(32)] == bp2);
+    TEST_ASSERT(mm_list_tailp[mm_list_class(32)] == bp2);
     TEST_ASSERT(mm_block_size(bp1) == 16);
     TEST_ASSERT(mm_block_allocated(bp1) == 1);
     TEST_ASSERT(mm_block_size(bp1+3) == 16);      // footer
@@ -88,16 +102,19 @@ void test_free_coalesce_alloc_free(void) {
 }
 
 void test_free_coalesce_free_alloc(void) {
-    BlockHeader *bp1 = new_block(16 + 16 + 16);
+    BlockHeader *bp1 = new_block(16 + 16 + 16 + 4);
     mm_block_set_header(bp1, 16, 0);
+    mm_block_set_prev_allocated(bp1, 1);
     mm_block_set_footer(bp1, 16, 0);
     BlockHeader *bp2 = mm_block_next(bp1);
     TEST_ASSERT(bp2 != NULL);
     mm_block_set_header(bp2, 16, 0);
+    mm_block_set_prev_allocated(bp2, 0);
     mm_block_set_footer(bp2, 16, 0);
     BlockHeader *bp3 = mm_block_next(bp2);
     TEST_ASSERT(bp3 != NULL);
     mm_block_set_header(bp3, 16, 1);
+    mm_block_set_prev_allocated(bp3, 0);
     mm_block_set_footer(bp3, 16, 1);
     *(bp3+1) = 0x03030303;  // payload of 8 bytes
     *(bp3+2) = 0x03030303;
@@ -108,8 +125,8 @@ void test_free_coalesce_free_alloc(void) {
     // must coalesce bp1 and bp2, no change to bp3
     BlockHeader *coalesced = free_coalesce(bp2);
     TEST_ASSERT(coalesced == bp1);
-    TEST_ASSERT(mm_list_headp == bp1);
-    TEST_ASSERT(mm_list_tailp == bp1);
+    TEST_ASSERT(mm_list_headp[mm_list_class(32)] == bp1);
+    TEST_ASSERT(mm_list_tailp[mm_list_class(32)] == bp1);
     TEST_ASSERT(mm_block_size(bp1) == 32);
     TEST_ASSERT(mm_block_allocated(bp1) == 0);
     TEST_ASSERT(mm_block_size(bp1+7) == 32);      // footer
@@ -123,16 +140,19 @@ void test_free_coalesce_free_alloc(void) {
 }
 
 void test_free_coalesce_free_free(void) {
-    BlockHeader *bp1 = new_block(16 + 16 + 16);
+    BlockHeader *bp1 = new_block(16 + 16 + 16 + 4);
     mm_block_set_header(bp1, 16, 0);
+    mm_block_set_prev_allocated(bp1, 1);
     mm_block_set_footer(bp1, 16, 0);
     BlockHeader *bp2 = mm_block_next(bp1);
     TEST_ASSERT(bp2 != NULL);
     mm_block_set_header(bp2, 16, 0);
+    mm_block_set_prev_allocated(bp2, 0);
     mm_block_set_footer(bp2, 16, 0);
     BlockHeader *bp3 = mm_block_next(bp2);
     TEST_ASSERT(bp3 != NULL);
     mm_block_set_header(bp3, 16, 0);
+    mm_block_set_prev_allocated(bp3, 0);
     mm_block_set_footer(bp3, 16, 0);
 
     mm_list_init();
@@ -142,8 +162,8 @@ void test_free_coalesce_free_free(void) {
     // must coalesce bp1, bp2, and bp3
     BlockHeader *coalesced = free_coalesce(bp2);
     TEST_ASSERT(coalesced == bp1);
-    TEST_ASSERT(mm_list_headp == bp1);
-    TEST_ASSERT(mm_list_tailp == bp1);
+    TEST_ASSERT(mm_list_headp[mm_list_class(48)] == bp1);
+    TEST_ASSERT(mm_list_tailp[mm_list_class(48)] == bp1);
     TEST_ASSERT(mm_block_size(bp1) == 48);
     TEST_ASSERT(mm_block_allocated(bp1) == 0);
     TEST_ASSERT(mm_block_size(bp1+11) == 48);      // footer
@@ -169,9 +189,32 @@ void test_find_fit(void) {
     TEST_ASSERT(bp == allocated);
 }
 
+void test_find_fit_bounded(void) {
+    // a class with only smaller blocks in front of the one that fits
+    mm_list_init();
+    BlockHeader *small[MM_FIT_SCAN_MAX];
+    for (int i = 0; i < MM_FIT_SCAN_MAX; i++) {
+        small[i] = new_block(512);
+        mm_block_set_header(small[i], 512, 0);
+        mm_block_set_footer(small[i], 512, 0);
+        mm_list_append(small[i]);
+    }
+    BlockHeader *fit = new_block(544);
+    mm_block_set_header(fit, 528, 0);
+    mm_block_set_footer(fit, 528, 0);
+    mm_list_append(fit);
+    TEST_ASSERT(mm_list_class(512) == mm_list_class(528));
+
+    // only the first MM_FIT_SCAN_MAX blocks are checked
+    TEST_ASSERT(find_fit(528) == NULL);
+    mm_list_remove(small[0]);
+    TEST_ASSERT(find_fit(528) == fit);
+}
+
 void test_place_small_leftover(void) {
-    BlockHeader *bp = new_block(16+8);
+    BlockHeader *bp = new_block(16+8+4);  // room for the next header
     mm_block_set_header(bp, 16+8, 0);
+    mm_block_set_prev_allocated(bp, 1);
     mm_block_set_footer(bp, 16+8, 0);
     mm_list_init();
     mm_list_append(bp);
@@ -181,13 +224,15 @@ void test_place_small_leftover(void) {
     TEST_ASSERT(placed == bp);
     TEST_ASSERT(mm_block_size(placed) == 16+8);
     TEST_ASSERT(mm_block_allocated(placed) == 1);
-    TEST_ASSERT(mm_list_headp == NULL);
-    TEST_ASSERT(mm_list_tailp == NULL);
+    TEST_ASSERT(mm_block_prev_allocated(mm_block_next(placed)) == 1);
+    TEST_ASSERT(mm_list_headp[mm_list_class(16+8)] == NULL);
+    TEST_ASSERT(mm_list_tailp[mm_list_class(16+8)] == NULL);
 }
 
 void test_place_small_leftover_bis(void) {
-    BlockHeader *bp = new_block(160+8);
+    BlockHeader *bp = new_block(160+8+4);  // room for the next header
     mm_block_set_header(bp, 160+8, 0);
+    mm_block_set_prev_allocated(bp, 1);
     mm_block_set_footer(bp, 160+8, 0);
     mm_list_init();
     mm_list_append(bp);
@@ -196,13 +241,14 @@ void test_place_small_leftover_bis(void) {
     TEST_ASSERT(placed == bp);
     TEST_ASSERT(mm_block_size(placed) == 160+8);
     TEST_ASSERT(mm_block_allocated(placed) == 1);
-    TEST_ASSERT(mm_list_headp == NULL);
-    TEST_ASSERT(mm_list_tailp == NULL);
+    TEST_ASSERT(mm_list_headp[mm_list_class(160+8)] == NULL);
+    TEST_ASSERT(mm_list_tailp[mm_list_class(160+8)] == NULL);
 }
 
 void test_place_large_leftover(void) {
-    BlockHeader *bp = new_block(16+16);
+    BlockHeader *bp = new_block(16+16+4);  // room for the next header
     mm_block_set_header(bp, 16+16, 0);
+    mm_block_set_prev_allocated(bp, 1);
     mm_block_set_footer(bp, 16+16, 0);
     mm_list_init();
     mm_list_append(bp);
@@ -211,11 +257,12 @@ void test_place_large_leftover(void) {
     TEST_ASSERT(placed != NULL);
     TEST_ASSERT(mm_block_size(placed) == 16);
     TEST_ASSERT(mm_block_allocated(placed) == 1);
-    TEST_ASSERT(mm_list_headp != placed);
-    TEST_ASSERT(mm_list_headp == mm_list_tailp);
-    TEST_ASSERT(mm_list_headp == mm_block_next(placed) || mm_list_headp == mm_block_prev(placed));
-    TEST_ASSERT(mm_block_size(mm_list_headp) == 16);
-    TEST_ASSERT(mm_block_allocated(mm_list_headp) == 0);
+    TEST_ASSERT(mm_list_headp[mm_list_class(16)] != placed);
+    TEST_ASSERT(mm_list_headp[mm_list_class(16)] == mm_list_tailp[mm_list_class(16)]);
+    TEST_ASSERT(mm_list_headp[mm_list_class(16)] == mm_block_next(placed) || mm_list_headp[mm_list_class(16)] == mm_block_prev(placed));
+    TEST_ASSERT(mm_block_size(mm_list_headp[mm_list_class(16)]) == 16);
+    TEST_ASSERT(mm_block_allocated(mm_list_headp[mm_list_class(16)]) == 0);
+    TEST_ASSERT(mm_block_prev_allocated(mm_list_headp[mm_list_class(16)]) == 1);
 }
 
 void test_malloc_free(void) {
@@ -247,6 +294,39 @@ void test_malloc_free(void) {
     mm_free(p2);
 }
 
+void test_required_block_size(void) {
+    // 4 bytes of header, no footer, at least 16 bytes, multiple of MM_ALIGNMENT
+    TEST_ASSERT(required_block_size(1) == 16);
+    TEST_ASSERT(required_block_size(12) == 16);
+    TEST_ASSERT(required_block_size(13) == 16 + MM_ALIGNMENT);
+    TEST_ASSERT(required_block_size(4092) == 4096);
+}
+
+void test_malloc_tiny(void) {
+    // tiny objects are in runs, without headers
+    char *p1 = mm_malloc(16);
+    char *p2 = mm_malloc(16);
+    TEST_ASSERT(mm_slab_contains(p1));
+    TEST_ASSERT(mm_slab_contains(p2));
+    TEST_ASSERT(p2 - p1 == 16 || p1 - p2 == 16);
+
+    // larger ones are not
+    char *p3 = mm_malloc(MM_SLAB_MAX + 1);
+    TEST_ASSERT(!mm_slab_contains(p3));
+
+    // realloc moves tiny objects out of their run when needed
+    p1[0] = 0x01;
+    char *p4 = mm_realloc(p1, 16);
+    TEST_ASSERT(p4 == p1);
+    p4 = mm_realloc(p1, 2 * MM_SLAB_MAX);
+    TEST_ASSERT(!mm_slab_contains(p4));
+    TEST_ASSERT(p4[0] == 0x01);
+
+    mm_free(p2);
+    mm_free(p3);
+    mm_free(p4);
+}
+
 void test_malloc_realloc_free(void) {
     int *p1 = mm_malloc(8);
     TEST_ASSERT(p1 != NULL);
@@ -286,6 +366,570 @@ void test_malloc_realloc_free(void) {
     mm_free(p2);
 }
 
+void test_realloc_heap_tail(void) {
+    mm_init();
+
+    // large blocks are placed at the end of the heap
+    char *p1 = mm_malloc(2000);
+    TEST_ASSERT(p1 != NULL);
+    BlockHeader *bp = (BlockHeader *)(p1 - 4);
+    TEST_ASSERT(mm_block_size(mm_block_next(bp)) == 0);
+    p1[0] = 0x01;
+    p1[1999] = 0x01;
+
+    // the heap grows by the missing bytes, the block doesn't move
+    long heapsize = mem_heapsize();
+    char *p2 = mm_realloc(p1, 3000);
+    TEST_ASSERT(p2 == p1);
+    TEST_ASSERT(mem_heapsize() == heapsize + (long)(required_block_size(3000) - required_block_size(2000)));
+    TEST_ASSERT(p2[0] == 0x01);
+    TEST_ASSERT(p2[1999] == 0x01);
+    TEST_ASSERT(mm_block_size(mm_block_next(bp)) == 0);
+    mm_free(p2);
+}
+
+void test_malloc_quick_bins(void) {
+    mm_init();
+
+    // (sizes above MM_TCACHE_MAX, not to go through the cache of the thread)
+    // a freed block is reused for the next request of the same size
+    char *p1 = mm_malloc(1000);
+    mm_free(p1);
+    BlockHeader *bp = (BlockHeader *)(p1 - 4);
+    TEST_ASSERT(mm_block_allocated(bp));
+    char *p2 = mm_malloc(1000);
+    TEST_ASSERT(p2 == p1);
+
+    // cached blocks are coalesced when no free block fits
+    char *p3 = mm_malloc(1000);
+    mm_free(p2);
+    mm_free(p3);
+    long heapsize = mem_heapsize();
+    char *p4 = mm_malloc(2000);
+    TEST_ASSERT(p4 != NULL);
+    TEST_ASSERT(mem_heapsize() == heapsize);
+    mm_free(p4);
+}
+
+void test_free_trim_heap(void) {
+    mm_init();
+    long empty_heapsize = mem_heapsize() - 528;  // before the initial extension
+
+    // a small free block at the end of the heap is kept
+    char *p1 = mm_malloc(MM_QUICK_MAX * 2);
+    long heapsize = mem_heapsize();
+    mm_free(p1);
+    TEST_ASSERT(mem_heapsize() == heapsize);
+
+    // a large one is given back, down to the empty heap (two blocks, since
+    // huge ones are not on the heap)
+    char *p2 = mm_malloc(MM_TRIM_THRESHOLD / 2);
+    char *p4 = mm_malloc(MM_TRIM_THRESHOLD / 2);
+    TEST_ASSERT(!mm_block_mapped((BlockHeader *)(p4 - 4)));
+    TEST_ASSERT(mem_heapsize() > MM_TRIM_THRESHOLD);
+    mm_free(p2);
+    mm_free(p4);
+    TEST_ASSERT(mem_heapsize() == empty_heapsize);
+    TEST_ASSERT(mem_peak_heapsize() > MM_TRIM_THRESHOLD);
+    TEST_ASSERT(mm_block_size(mm_block_next(heap_blocks)) == 0);
+
+    // the heap can grow again
+    char *p3 = mm_malloc(1000);
+    TEST_ASSERT(p3 != NULL);
+    mm_free(p3);
+}
+
+void test_free_trim_cached(void) {
+    // blocks small enough to be cached (quick bins, thread cache, runs), freed
+    // in any order, don't keep the heap from shrinking
+    enum { COUNT = 2000 };
+    static char *p[COUNT];
+    for (int order = 0; order < 3; order++) {
+        mem_reset_brk();
+        mm_init();
+        for (int k = 0; k < COUNT; k++)
+            p[k] = mm_malloc(1 + (k * 7919) % 4100);
+        TEST_ASSERT(mem_heapsize() > 16 * MM_TRIM_THRESHOLD);
+        for (int i = 0; i < COUNT; i++) {
+            int k = (order == 0) ? i : (order == 1) ? COUNT - 1 - i : (i * 1237) % COUNT;
+            mm_free(p[k]);
+        }
+        TEST_ASSERT(mem_heapsize() < 2 * MM_TRIM_THRESHOLD);
+        TEST_ASSERT(mm_check());
+    }
+}
+
+/**
+ * Check that `size` bytes starting at `p` are all zero.
+ */
+static int all_zero(char *p, int size) {
+    for (int i = 0; i < size; i++) {
+        if (p[i] != 0)
+            return 0;
+    }
+    return 1;
+}
+
+void test_calloc_zeroed(void) {
+    mm_init();
+
+    // fresh memory from mem_sbrk is zeroed, also after coalescing
+    TEST_ASSERT(mm_block_zeroed(mm_block_next(heap_blocks)));
+    char *p1 = mm_malloc(MM_QUICK_MAX * 2);
+    BlockHeader *free_bp = mm_block_next(heap_blocks);
+    TEST_ASSERT(!mm_block_allocated(free_bp));
+    TEST_ASSERT(mm_block_zeroed(free_bp));
+    TEST_ASSERT(all_zero(mm_block_payload_addr(free_bp) + MM_BLOCK_LINKS,
+                         mm_block_size(free_bp) - 4 - MM_BLOCK_LINKS - 4));
+
+    // a freed block is not zeroed
+    memset(p1, 0xff, MM_QUICK_MAX * 2);
+    mm_free(p1);
+    TEST_ASSERT(!mm_block_zeroed(mm_block_next(heap_blocks)));
+
+    // calloc clears both
+    char *p2 = mm_calloc(MM_QUICK_MAX, 2);
+    TEST_ASSERT(p2 != NULL);
+    TEST_ASSERT(all_zero(p2, MM_QUICK_MAX * 2));
+    char *p3 = mm_calloc(100, 100);
+    TEST_ASSERT(p3 != NULL);
+    TEST_ASSERT(all_zero(p3, 10000));
+    char *p4 = mm_calloc(2, 8);
+    TEST_ASSERT(p4 != NULL);
+    TEST_ASSERT(all_zero(p4, 16));
+
+    // the total size overflows
+    TEST_ASSERT(mm_calloc(SIZE_MAX / 2, 4) == NULL);
+    mm_free(p2);
+    mm_free(p3);
+    mm_free(p4);
+}
+
+void test_memalign(void) {
+    mm_init();
+
+    int alignments[] = {16, 64, 4096, 8};
+    char *p[4];
+    for (int i = 0; i < 4; i++) {
+        p[i] = mm_memalign(alignments[i], 100);
+        TEST_ASSERT(p[i] != NULL);
+        TEST_ASSERT((uintptr_t)p[i] % alignments[i] == 0);
+        memset(p[i], i + 1, 100);
+    }
+
+    // the space before the payload was freed
+    BlockHeader *bp = (BlockHeader *)(p[2] - 4);
+    TEST_ASSERT(mm_block_size(bp) == required_block_size(100));
+    TEST_ASSERT(!mm_block_prev_allocated(bp));
+    TEST_ASSERT(mm_block_size(mm_block_prev(bp)) >= 16);
+
+    // aligned blocks can be reallocated and freed
+    char *q = mm_realloc(p[1], 5000);
+    TEST_ASSERT(q != NULL);
+    TEST_ASSERT(q[0] == 2 && q[99] == 2);
+    TEST_ASSERT(mm_aligned_alloc(3, 100) == NULL);
+    TEST_ASSERT(mm_memalign(0, 100) == NULL);
+    mm_free(p[0]);
+    mm_free(q);
+    mm_free(p[2]);
+    mm_free(p[3]);
+}
+
+void test_malloc_mapped(void) {
+    long heapsize = mem_heapsize();
+
+    // huge blocks are in mappings of their own, outside of the heap
+    char *p1 = mm_malloc(MM_MMAP_THRESHOLD);
+    TEST_ASSERT(p1 != NULL);
+    TEST_ASSERT((uintptr_t)p1 % MM_ALIGNMENT == 0);
+    TEST_ASSERT(p1 < mem_heap_lo() || p1 > mem_heap_hi());
+    TEST_ASSERT(mem_mapped(p1, p1 + MM_MMAP_THRESHOLD - 1));
+    TEST_ASSERT(mm_block_mapped((BlockHeader *)(p1 - 4)));
+    TEST_ASSERT(mem_heapsize() >= heapsize + MM_MMAP_THRESHOLD);
+    p1[0] = 0x01;
+    p1[MM_MMAP_THRESHOLD - 1] = 0x01;
+
+    // they grow and shrink with their mapping
+    char *p2 = mm_realloc(p1, 4 * MM_MMAP_THRESHOLD);
+    TEST_ASSERT(p2 != NULL);
+    TEST_ASSERT(mem_mapped(p2, p2 + 4 * MM_MMAP_THRESHOLD - 1));
+    TEST_ASSERT(p2[0] == 0x01 && p2[MM_MMAP_THRESHOLD - 1] == 0x01);
+    TEST_ASSERT(mem_heapsize() >= heapsize + 4 * MM_MMAP_THRESHOLD);
+
+    // and move back to the heap when they become small
+    char *p3 = mm_realloc(p2, 100);
+    TEST_ASSERT(p3 >= mem_heap_lo() && p3 <= mem_heap_hi());
+    TEST_ASSERT(p3[0] == 0x01);
+    TEST_ASSERT(mem_heapsize() < heapsize + MM_MMAP_THRESHOLD);
+    mm_free(p3);
+
+    // they are zeroed, and unmapped right away when freed
+    char *p4 = mm_calloc(MM_MMAP_THRESHOLD, 2);
+    TEST_ASSERT(p4 != NULL);
+    TEST_ASSERT(all_zero(p4, 2 * MM_MMAP_THRESHOLD));
+    mm_free(p4);
+    TEST_ASSERT(!mem_mapped(p4, p4));
+    TEST_ASSERT(mm_check());
+}
+
+void test_memalign_mapped(void) {
+    long heapsize = mem_heapsize();
+
+    // huge aligned blocks get a mapping too, even larger than a region
+    size_t alignments[] = {64, 4096, 1 << 20, 64};
+    size_t sizes[] = {MM_MMAP_THRESHOLD, 3 * MM_MMAP_THRESHOLD, 100, 50 << 20};
+    char *p[4];
+    for (int i = 0; i < 4; i++) {
+        p[i] = mm_memalign(alignments[i], sizes[i]);
+        TEST_ASSERT(p[i] != NULL);
+        TEST_ASSERT((uintptr_t)p[i] % alignments[i] == 0);
+        TEST_ASSERT(mem_mapped(p[i], p[i] + sizes[i] - 1));
+        TEST_ASSERT(mm_block_mapped((BlockHeader *)(p[i] - 4)));
+        memset(p[i], i + 1, sizes[i]);
+    }
+
+    // they keep their place in the mapping when resized
+    char *q = mm_realloc(p[1], 8 * MM_MMAP_THRESHOLD);
+    TEST_ASSERT(q != NULL);
+    TEST_ASSERT(q[0] == 2 && q[3 * MM_MMAP_THRESHOLD - 1] == 2);
+    TEST_ASSERT(mem_mapped(q, q + 8 * MM_MMAP_THRESHOLD - 1));
+
+    // and are unmapped right away when freed
+    mm_free(p[0]);
+    mm_free(q);
+    mm_free(p[2]);
+    mm_free(p[3]);
+    TEST_ASSERT(!mem_mapped(p[3], p[3]));
+    TEST_ASSERT(mem_heapsize() == heapsize);
+    TEST_ASSERT(mm_check());
+}
+
+void test_check_heap_map(void) {
+    void *p[64] = { NULL };
+    for (int i = 0; i < 1000; i++) {
+        int k = (i * 37) % 64;
+        size_t size = 1 + (i * 7919) % 6000;
+        if (p[k] == NULL)
+            p[k] = (i % 5 == 0) ? mm_memalign(64, size) : mm_malloc(size);
+        else if (i % 3 == 0)
+            p[k] = mm_realloc(p[k], size);
+        else {
+            mm_free(p[k]);
+            p[k] = NULL;
+        }
+        TEST_ASSERT(mm_check());
+    }
+
+#ifdef MM_HEAP_MAP
+    // the heap map gives free space without reading headers
+    BlockHeader *epilogue = (BlockHeader *)(mem_heap_hi() + 1) - 1;
+    size_t free_bytes = 0, largest = 0;
+    for (BlockHeader *bp = heap_blocks; bp != epilogue; bp = mm_block_next(bp)) {
+        if (!mm_block_allocated(bp)) {
+            free_bytes += mm_block_size(bp);
+            largest = MAX(largest, mm_block_size(bp));
+        }
+    }
+    TEST_ASSERT(mm_heapmap_free_bytes(epilogue) == free_bytes);
+    TEST_ASSERT(mm_heapmap_largest_free(epilogue) == largest);
+    BlockHeader *bp = mm_heapmap_find(heap_blocks, epilogue, largest);
+    TEST_ASSERT(largest > 0 && bp != NULL);
+    TEST_ASSERT(!mm_block_allocated(bp) && mm_block_size(bp) == largest);
+#endif
+
+    for (int k = 0; k < 64; k++)
+        if (p[k] != NULL)
+            mm_free(p[k]);
+    TEST_ASSERT(mm_check());
+}
+
+/**
+ * Check the stats measured on the heap map against the block headers.
+ */
+static int stats_match_headers(void) {
+    MMStats stats;
+    mm_get_stats(&stats);
+    size_t free_bytes = 0, free_blocks = 0, largest_free = 0;
+    for (int i = 0; i < mem_regions(); i++) {
+        BlockHeader *bp = (i == 0) ? heap_blocks : region_prologue(mem_region_lo(i));
+        for (; mm_block_size(bp) != 0; bp = mm_block_next(bp)) {
+            if (!mm_block_allocated(bp)) {
+                free_bytes += mm_block_size(bp);
+                free_blocks++;
+                largest_free = MAX(largest_free, mm_block_size(bp));
+            }
+        }
+    }
+    return stats.free_bytes == free_bytes && stats.free_blocks == free_blocks &&
+           stats.largest_free == largest_free;
+}
+
+void test_stats(void) {
+    // the initial extension is the only free block
+    MMStats stats;
+    mm_get_stats(&stats);
+    TEST_ASSERT(stats.heap_size == (size_t)mem_heapsize());
+    TEST_ASSERT(stats.free_blocks == 1 && stats.free_bytes == 528 && stats.largest_free == 528);
+
+    // holes between allocated blocks (too large to be cached)
+    void *p[8];
+    for (int k = 0; k < 8; k++)
+        p[k] = mm_malloc(5000 + 1000 * k);
+    mm_free(p[1]);
+    mm_free(p[5]);
+    mm_get_stats(&stats);
+    TEST_ASSERT(stats.free_blocks >= 2);
+    TEST_ASSERT(stats.largest_free >= required_block_size(10000));
+    TEST_ASSERT(stats_match_headers());
+
+    for (int k = 0; k < 8; k++)
+        if (k != 1 && k != 5)
+            mm_free(p[k]);
+}
+
+void test_sbrk_given_back_zeroed(void) {
+    // memory given back (resident or discarded) is zero when taken again
+    size_t size = 8 * 1024 * 1024;
+    char *lo = mem_sbrk(size);
+    TEST_ASSERT(lo != (char *)-1);
+    memset(lo, 0xFF, size);
+    TEST_ASSERT(mem_sbrk(-(intptr_t)size) != (char *)-1);
+    TEST_ASSERT(mem_sbrk(size) == lo);
+    TEST_ASSERT(all_zero(lo, size));
+}
+
+/**
+ * Count the resident pages of the range [lo, hi).
+ */
+static size_t resident_pages(char *lo, char *hi) {
+    char *page = (char *)((uintptr_t)lo & ~(uintptr_t)(MEM_PAGE_SIZE - 1));
+    static unsigned char vec[8192];
+    size_t pages = (hi - page + MEM_PAGE_SIZE - 1) / MEM_PAGE_SIZE;
+    TEST_ASSERT(pages <= sizeof(vec) && mincore(page, hi - page, vec) == 0);
+    size_t count = 0;
+    for (size_t i = 0; i < pages; i++)
+        count += vec[i] & 1;
+    return count;
+}
+
+void test_sbrk_retains_once(void) {
+    // moving the break down by steps keeps at most 4 MiB resident above it
+    // (not 4 MiB for each step), once more than 16 MiB are resident
+    size_t size = 8 * 1024 * 1024;
+    char *lo = mem_sbrk(3 * size);
+    TEST_ASSERT(lo != (char *)-1);
+    memset(lo, 0xFF, 3 * size);
+    for (int i = 0; i < 3; i++)
+        TEST_ASSERT(mem_sbrk(-(intptr_t)size) != (char *)-1);
+    TEST_ASSERT(resident_pages(lo, lo + 3 * size) <= 4 * 1024 * 1024 / MEM_PAGE_SIZE + 1);
+    TEST_ASSERT(mem_sbrk(3 * size) == lo);
+    TEST_ASSERT(all_zero(lo, 3 * size));
+}
+
+void test_malloc_regions(void) {
+    // blocks beyond MAX_HEAP bytes continue on a new region of the heap
+    enum { COUNT = MAX_HEAP / 50000 + 100 };
+    static char *p[COUNT];
+    for (int k = 0; k < COUNT; k++) {
+        p[k] = mm_malloc(100000);
+        TEST_ASSERT(p[k] != NULL);
+        TEST_ASSERT((uintptr_t)p[k] % MM_ALIGNMENT == 0);
+        TEST_ASSERT(mem_in_heap(p[k], p[k] + 100000 - 1));
+        p[k][0] = p[k][100000 - 1] = (char)k;
+    }
+    TEST_ASSERT(mem_regions() >= 2);
+    TEST_ASSERT(mem_heapsize() >= (long)COUNT * 100000);
+    TEST_ASSERT(mm_check());
+
+    // free blocks are found in all regions (and never merged across gaps)
+    for (int k = 0; k < COUNT; k += 2)
+        mm_free(p[k]);
+    TEST_ASSERT(mm_check());
+    TEST_ASSERT(stats_match_headers());
+    int regions = mem_regions();
+    for (int k = 0; k < COUNT; k += 2) {
+        p[k] = mm_malloc(100000);
+        TEST_ASSERT(p[k] != NULL);
+    }
+    TEST_ASSERT(mem_regions() == regions);
+    for (int k = 1; k < COUNT; k += 2)
+        TEST_ASSERT(p[k][0] == (char)k && p[k][100000 - 1] == (char)k);
+    for (int k = 0; k < COUNT; k++)
+        mm_free(p[k]);
+    TEST_ASSERT(mm_check());
+}
+
+void test_region_larger_than_max_heap(void) {
+    // a block larger than MAX_HEAP gets a region of several slots
+    int regions = mem_regions();
+    long heapsize = mem_heapsize();
+    size_t size = MAX_HEAP + MAX_HEAP / 2;
+    BlockHeader *bp = place(extend_heap(size), size);
+    TEST_ASSERT(bp != NULL);
+    TEST_ASSERT(mem_regions() == regions + 1);
+    TEST_ASSERT(mem_region_hi(regions) - mem_region_lo(regions) >= (long)size);
+    char *p = mm_block_payload_addr(bp);
+    TEST_ASSERT(mem_in_heap(p, p + size - 5));
+    p[0] = p[size - 5] = 0x01;
+    TEST_ASSERT(mm_check());
+
+    // given back to memlib when freed
+    mm_free(p);
+    TEST_ASSERT(mem_heapsize() < heapsize + MM_TRIM_THRESHOLD);
+    TEST_ASSERT(mm_check());
+}
+
+#define THREADS 4
+#define THREAD_OBJECTS 64
+
+static void *alloc_objects(void *arg) {
+    char **objects = arg;
+    long overwritten = 0;  // (assertions can't fail outside the main thread)
+    for (int i = 0; i < 5000; i++) {
+        int k = (i * 37) % THREAD_OBJECTS;
+        size_t size = 1 + (k * 97) % 1500;
+        if (objects[k] != NULL) {
+            // check that no other thread wrote on it
+            for (size_t j = 0; j < size; j += 16)
+                overwritten += (objects[k][j] != (char)k);
+            mm_free(objects[k]);
+            objects[k] = NULL;
+        } else if (i % 2 == 0) {
+            objects[k] = mm_malloc(size);
+            if (objects[k] == NULL)
+                return (void *)1;
+            memset(objects[k], k, size);
+        }
+    }
+    return (void *)overwritten;
+}
+
+static void *free_objects(void *arg) {
+    char **objects = arg;
+    for (int k = 0; k < THREAD_OBJECTS; k++)
+        mm_free(objects[k]);
+    return NULL;
+}
+
+void test_threads(void) {
+    static char *objects[THREADS][THREAD_OBJECTS];
+    pthread_t threads[THREADS];
+    for (int t = 0; t < THREADS; t++)
+        pthread_create(&threads[t], NULL, alloc_objects, objects[t]);
+    for (int t = 0; t < THREADS; t++) {
+        void *errors;
+        pthread_join(threads[t], &errors);
+        TEST_ASSERT(errors == NULL);
+    }
+    TEST_ASSERT(mm_check());
+
+    // objects freed by other threads than the one that allocated them (the
+    // cache of each thread is given back to the heap when it exits)
+    for (int t = 0; t < THREADS; t++)
+        pthread_create(&threads[t], NULL, free_objects, objects[(t + 1) % THREADS]);
+    for (int t = 0; t < THREADS; t++)
+        pthread_join(threads[t], NULL);
+    TEST_ASSERT(mm_check());
+}
+
+#define MESSAGES 8
+
+static void *consume_messages(void *arg) {
+    char **messages = arg;
+    for (int i = 0; i < MESSAGES; i++)
+        mm_free(messages[i]);
+    return NULL;
+}
+
+void test_threads_remote_free(void) {
+    // messages allocated by this thread, freed by another one
+    char *first[MESSAGES];
+    char *messages[MESSAGES];
+    pthread_t thread;
+    for (int i = 0; i < MESSAGES; i++)
+        first[i] = messages[i] = mm_malloc(100);
+    pthread_create(&thread, NULL, consume_messages, messages);
+    pthread_join(thread, NULL);
+
+    // they come back to this thread through its inbox
+    long heapsize = mem_heapsize();
+    for (int round = 0; round < 100; round++) {
+        for (int i = 0; i < MESSAGES; i++) {
+            messages[i] = mm_malloc(100);
+            memset(messages[i], round, 100);
+            int reused = 0;
+            for (int j = 0; j < MESSAGES; j++)
+                reused |= (messages[i] == first[j]);
+            TEST_ASSERT(reused);
+        }
+        pthread_create(&thread, NULL, consume_messages, messages);
+        pthread_join(thread, NULL);
+    }
+    TEST_ASSERT(mem_heapsize() == heapsize);
+    TEST_ASSERT(mm_check());
+}
+
+#define PRODUCED 2000
+
+static void *produce_messages(void *arg) {
+    char **messages = arg;
+    for (int i = 0; i < PRODUCED; i++) {
+        messages[i] = mm_malloc(48);
+        memset(messages[i], i, 48);
+    }
+    return NULL;
+}
+
+void test_threads_owner_exited(void) {
+    // this thread has an id of its own
+    mm_free(mm_malloc(48));
+
+    // messages allocated by a thread that exits before they are freed
+    static char *messages[PRODUCED];
+    pthread_t thread;
+    pthread_create(&thread, NULL, produce_messages, messages);
+    pthread_join(thread, NULL);
+    for (int i = 0; i < PRODUCED; i++)
+        mm_free(messages[i]);
+
+    // they are freed here (not left in the inbox of the id), so reused
+    long heapsize = mem_heapsize();
+    for (int i = 0; i < PRODUCED; i++)
+        messages[i] = mm_malloc(48);
+    TEST_ASSERT(mem_heapsize() == heapsize);
+    TEST_ASSERT(mm_tcache_take_inbox() == NULL);
+    for (int i = 0; i < PRODUCED; i++)
+        mm_free(messages[i]);
+    TEST_ASSERT(mm_check());
+}
+
+static void *calloc_free(void *arg) {
+    (void)arg;
+    char *p[MESSAGES];
+    for (int i = 0; i < MESSAGES; i++)
+        p[i] = mm_calloc(1, 100);
+    for (int i = 0; i < MESSAGES; i++)
+        mm_free(p[i]);
+    return NULL;
+}
+
+void test_threads_untagged(void) {
+    // objects of this thread given back to the heap
+    char *p[4 * MESSAGES];
+    for (int i = 0; i < 4 * MESSAGES; i++)
+        p[i] = mm_malloc(100);
+    for (int i = 0; i < 4 * MESSAGES; i++)
+        mm_free(p[i]);
+
+    // taken again (not through the cache) by another thread, which frees them
+    // itself instead of pushing them to the inbox of this thread
+    pthread_t thread;
+    pthread_create(&thread, NULL, calloc_free, NULL);
+    pthread_join(thread, NULL);
+    TEST_ASSERT(mm_tcache_take_inbox() == NULL);
+    TEST_ASSERT(mm_check());
+}
+
 int main(void) {
     UNITY_BEGIN();
     mem_init();
@@ -294,11 +938,32 @@ int main(void) {
     RUN_TEST(test_free_coalesce_free_alloc);
     RUN_TEST(test_free_coalesce_free_free);
     RUN_TEST(test_find_fit);
+    RUN_TEST(test_find_fit_bounded);
     RUN_TEST(test_place_small_leftover);
     RUN_TEST(test_place_small_leftover_bis);
     RUN_TEST(test_place_large_leftover);
     RUN_TEST(test_malloc_free);
+    RUN_TEST(test_required_block_size);
+    RUN_TEST(test_malloc_tiny);
     RUN_TEST(test_malloc_realloc_free);
+    RUN_TEST(test_realloc_heap_tail);
+    RUN_TEST(test_malloc_quick_bins);
+    RUN_TEST(test_free_trim_heap);
+    RUN_TEST(test_free_trim_cached);
+    RUN_TEST(test_calloc_zeroed);
+    RUN_TEST(test_memalign);
+    RUN_TEST(test_malloc_mapped);
+    RUN_TEST(test_memalign_mapped);
+    RUN_TEST(test_check_heap_map);
+    RUN_TEST(test_stats);
+    RUN_TEST(test_sbrk_given_back_zeroed);
+    RUN_TEST(test_sbrk_retains_once);
+    RUN_TEST(test_malloc_regions);
+    RUN_TEST(test_region_larger_than_max_heap);
+    RUN_TEST(test_threads);
+    RUN_TEST(test_threads_remote_free);
+    RUN_TEST(test_threads_owner_exited);
+    RUN_TEST(test_threads_untagged);
     mem_deinit();
     return UNITY_END();
 }
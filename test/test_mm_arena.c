@@ -0,0 +1,108 @@
+#include "unity.h"
+#include "memlib.h"
+
+#include "mm.h"
+#include "mm_arena.h"
+
+#include <stdint.h>
+
+void setUp(void) {
+    mem_reset_brk();
+    mm_init();
+}
+
+void tearDown(void) {
+
+}
+
+void test_malloc_bump(void) {
+    MMArena *arena = mm_arena_create();
+    TEST_ASSERT(arena != NULL);
+
+    // consecutive objects, aligned
+    char *p1 = mm_arena_malloc(arena, 1);
+    char *p2 = mm_arena_malloc(arena, 24);
+    char *p3 = mm_arena_malloc(arena, 8);
+    TEST_ASSERT(p1 != NULL);
+    TEST_ASSERT((uintptr_t)p1 % MM_ALIGNMENT == 0);
+    TEST_ASSERT(p2 == p1 + MM_ALIGNMENT);
+    TEST_ASSERT(p3 == p2 + (24 + MM_ALIGNMENT - 1) / MM_ALIGNMENT * MM_ALIGNMENT);
+    TEST_ASSERT(mm_arena_malloc(arena, 0) == NULL);
+
+    mm_arena_destroy(arena);
+    TEST_ASSERT(mm_check());
+}
+
+void test_malloc_new_chunk(void) {
+    MMArena *arena = mm_arena_create();
+
+    // objects fill more than one chunk without overlapping
+    char *prev = mm_arena_malloc(arena, 1000);
+    for (int i = 0; i < 2 * MM_ARENA_CHUNK_SIZE / 1000; i++) {
+        char *p = mm_arena_malloc(arena, 1000);
+        TEST_ASSERT(p != NULL);
+        TEST_ASSERT(p >= prev + 1000 || p + 1000 <= prev);
+        p[0] = 0x01;
+        p[999] = 0x01;
+        prev = p;
+    }
+
+    // large objects get their own chunk, the current one is still used
+    char *p1 = mm_arena_malloc(arena, 16);
+    char *large = mm_arena_malloc(arena, MM_ARENA_CHUNK_SIZE);
+    char *p2 = mm_arena_malloc(arena, 16);
+    TEST_ASSERT(large != NULL);
+    large[MM_ARENA_CHUNK_SIZE - 1] = 0x01;
+    TEST_ASSERT(p2 == p1 + 16);
+
+    mm_arena_destroy(arena);
+    TEST_ASSERT(mm_check());
+}
+
+void test_reset(void) {
+    MMArena *arena = mm_arena_create();
+    for (int i = 0; i < 1000; i++)
+        mm_arena_malloc(arena, 500);
+    mm_arena_malloc(arena, MM_ARENA_CHUNK_SIZE);
+
+    // all objects are freed at once, one chunk is kept
+    mm_arena_reset(arena);
+    TEST_ASSERT(mm_check());
+    char *p = mm_arena_malloc(arena, 16);
+    TEST_ASSERT(p != NULL);
+    TEST_ASSERT(mm_arena_malloc(arena, 16) == p + 16);
+
+    // the heap doesn't grow when the arena is reused
+    for (int i = 0; i < 1000; i++)
+        mm_arena_malloc(arena, 500);
+    mm_arena_reset(arena);
+    long heapsize = mem_heapsize();
+    for (int round = 0; round < 10; round++) {
+        for (int i = 0; i < 1000; i++)
+            mm_arena_malloc(arena, 500);
+        mm_arena_reset(arena);
+    }
+    TEST_ASSERT(mem_heapsize() == heapsize);
+
+    mm_arena_destroy(arena);
+    TEST_ASSERT(mm_check());
+}
+
+void test_reset_empty(void) {
+    MMArena *arena = mm_arena_create();
+    mm_arena_reset(arena);
+    TEST_ASSERT(mm_arena_malloc(arena, 10) != NULL);
+    mm_arena_destroy(arena);
+    TEST_ASSERT(mm_check());
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    mem_init();
+    RUN_TEST(test_malloc_bump);
+    RUN_TEST(test_malloc_new_chunk);
+    RUN_TEST(test_reset);
+    RUN_TEST(test_reset_empty);
+    mem_deinit();
+    return UNITY_END();
+}
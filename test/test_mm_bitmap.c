@@ -0,0 +1,73 @@
+#include "unity.h"
+#include "memlib.h"
+
+#include "mm.h"
+#include "mm_bitmap.h"
+
+void setUp(void) {
+    mm_bitmap_init();
+}
+
+void tearDown(void) {
+
+}
+
+void test_find_empty(void) {
+    TEST_ASSERT(mm_bitmap_find(0) == -1);
+    TEST_ASSERT(mm_bitmap_find(MM_LIST_CLASSES - 1) == -1);
+    TEST_ASSERT(mm_bitmap_find(MM_LIST_CLASSES) == -1);
+}
+
+void test_find_same_class(void) {
+    mm_bitmap_set(5);
+    TEST_ASSERT(mm_bitmap_find(5) == 5);
+    TEST_ASSERT(mm_bitmap_find(0) == 5);
+    TEST_ASSERT(mm_bitmap_find(6) == -1);
+}
+
+void test_find_same_range(void) {
+    int cls = 3 * MM_LIST_SL_COUNT + 2;
+    mm_bitmap_set(cls);
+    mm_bitmap_set(cls + 4);
+    TEST_ASSERT(mm_bitmap_find(cls) == cls);
+    TEST_ASSERT(mm_bitmap_find(cls + 1) == cls + 4);
+    TEST_ASSERT(mm_bitmap_find(cls + 5) == -1);
+}
+
+void test_find_next_range(void) {
+    int cls = 3 * MM_LIST_SL_COUNT + 2;
+    mm_bitmap_set(cls);
+    mm_bitmap_set(7 * MM_LIST_SL_COUNT + 9);
+    TEST_ASSERT(mm_bitmap_find(cls + 1) == 7 * MM_LIST_SL_COUNT + 9);
+    TEST_ASSERT(mm_bitmap_find(4 * MM_LIST_SL_COUNT) == 7 * MM_LIST_SL_COUNT + 9);
+}
+
+void test_find_last_class(void) {
+    mm_bitmap_set(MM_LIST_CLASSES - 1);
+    TEST_ASSERT(mm_bitmap_find(0) == MM_LIST_CLASSES - 1);
+    TEST_ASSERT(mm_bitmap_find(MM_LIST_CLASSES - 1) == MM_LIST_CLASSES - 1);
+}
+
+void test_clear(void) {
+    int cls = 3 * MM_LIST_SL_COUNT + 2;
+    mm_bitmap_set(cls);
+    mm_bitmap_set(cls + 1);
+    mm_bitmap_set(5 * MM_LIST_SL_COUNT);
+    mm_bitmap_clear(cls);
+    TEST_ASSERT(mm_bitmap_find(0) == cls + 1);
+    mm_bitmap_clear(cls + 1);
+    TEST_ASSERT(mm_bitmap_find(0) == 5 * MM_LIST_SL_COUNT);
+    mm_bitmap_clear(5 * MM_LIST_SL_COUNT);
+    TEST_ASSERT(mm_bitmap_find(0) == -1);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_find_empty);
+    RUN_TEST(test_find_same_class);
+    RUN_TEST(test_find_same_range);
+    RUN_TEST(test_find_next_range);
+    RUN_TEST(test_find_last_class);
+    RUN_TEST(test_clear);
+    return UNITY_END();
+}
@@ -7,9 +7,9 @@
 #include <stdlib.h>
 
 static BlockHeader *new_block(int size) {
-    // NOTE: here we are allocating blocks with malloc, but
+    // NOTE: here we are allocating blocks with calloc, but
     // mm.c should allocate them on the heap that you're managing
-    return malloc(size);
+    return calloc(1, size);
 }
 
 void setUp(void) {
@@ -27,6 +27,60 @@ void test_mm_block_header(void) {
     TEST_ASSERT(mm_block_size(bp) == 16);
 }
 
+void test_mm_block_prev_allocated(void) {
+    BlockHeader *bp = new_block(16);
+    mm_block_set_header(bp, 16, 1);
+    mm_block_set_prev_allocated(bp, 1);
+    TEST_ASSERT(mm_block_prev_allocated(bp) == 1);
+    TEST_ASSERT(mm_block_allocated(bp) == 1);
+    TEST_ASSERT(mm_block_size(bp) == 16);
+
+    // the bit is kept when the header is rewritten
+    mm_block_set_header(bp, 24, 0);
+    TEST_ASSERT(mm_block_prev_allocated(bp) == 1);
+    TEST_ASSERT(mm_block_allocated(bp) == 0);
+    TEST_ASSERT(mm_block_size(bp) == 24);
+
+    mm_block_set_prev_allocated(bp, 0);
+    TEST_ASSERT(mm_block_prev_allocated(bp) == 0);
+    TEST_ASSERT(mm_block_allocated(bp) == 0);
+    TEST_ASSERT(mm_block_size(bp) == 24);
+}
+
+void test_mm_block_zeroed(void) {
+    BlockHeader *bp = new_block(16);
+    mm_block_set_header(bp, 16, 0);
+    mm_block_set_prev_allocated(bp, 1);
+    TEST_ASSERT(mm_block_zeroed(bp) == 0);
+
+    mm_block_set_zeroed(bp, 1);
+    TEST_ASSERT(mm_block_zeroed(bp) == 1);
+    TEST_ASSERT(mm_block_prev_allocated(bp) == 1);
+    TEST_ASSERT(mm_block_allocated(bp) == 0);
+    TEST_ASSERT(mm_block_size(bp) == 16);
+
+    // the bit is cleared when the header is rewritten
+    mm_block_set_header(bp, 16, 0);
+    TEST_ASSERT(mm_block_zeroed(bp) == 0);
+    TEST_ASSERT(mm_block_prev_allocated(bp) == 1);
+}
+
+void test_mm_block_mapped(void) {
+    BlockHeader *bp = new_block(16);
+    mm_block_set_header(bp, 4096, 1);
+    TEST_ASSERT(mm_block_mapped(bp) == 0);
+
+    mm_block_set_mapped(bp, 1);
+    TEST_ASSERT(mm_block_mapped(bp) == 1);
+    TEST_ASSERT(mm_block_allocated(bp) == 1);
+    TEST_ASSERT(mm_block_size(bp) == 4096);
+
+    // only allocated blocks are mapped (the bit means "zeroed" on free ones)
+    mm_block_set_header(bp, 4096, 0);
+    mm_block_set_zeroed(bp, 1);
+    TEST_ASSERT(mm_block_mapped(bp) == 0);
+}
+
 void test_mm_block_footer(void) {
     BlockHeader *bp = new_block(16);
     mm_block_set_header(bp, 16, 1);
@@ -73,6 +127,9 @@ int main(void) {
     UNITY_BEGIN();
     mem_init();
     RUN_TEST(test_mm_block_header);
+    RUN_TEST(test_mm_block_prev_allocated);
+    RUN_TEST(test_mm_block_zeroed);
+    RUN_TEST(test_mm_block_mapped);
     RUN_TEST(test_mm_block_footer);
     RUN_TEST(test_mm_block_payload_addr);
     RUN_TEST(test_mm_block_prev_next);
@@ -0,0 +1,107 @@
+#include "unity.h"
+#include "memlib.h"
+
+#include "mm.h"
+#include "mm_heapmap.h"
+
+static char heap[64 * 1024];
+
+/**
+ * Address of the granule at `offset` bytes in the test heap.
+ */
+static BlockHeader *at(int offset) {
+    return (BlockHeader *)(heap + offset);
+}
+
+void setUp(void) {
+    mm_heapmap_init(at(0));
+}
+
+void tearDown(void) {
+
+}
+
+void test_empty(void) {
+    TEST_ASSERT(mm_heapmap_allocated(at(0)) == 0);
+    TEST_ASSERT(mm_heapmap_next_free(at(0), at(4096)) == at(0));
+    TEST_ASSERT(mm_heapmap_next_allocated(at(0), at(4096)) == at(4096));
+    TEST_ASSERT(mm_heapmap_find(at(0), at(4096), 4096) == at(0));
+    TEST_ASSERT(mm_heapmap_find(at(0), at(4096), 4104) == NULL);
+    TEST_ASSERT(mm_heapmap_free_bytes(at(4096)) == 4096);
+    TEST_ASSERT(mm_heapmap_largest_free(at(4096)) == 4096);
+    TEST_ASSERT(mm_heapmap_free_runs(at(4096)) == 1);
+}
+
+void test_set_clear(void) {
+    mm_heapmap_set(at(16), 24);
+    TEST_ASSERT(mm_heapmap_allocated(at(8)) == 0);
+    TEST_ASSERT(mm_heapmap_allocated(at(16)) == 1);
+    TEST_ASSERT(mm_heapmap_allocated(at(32)) == 1);
+    TEST_ASSERT(mm_heapmap_allocated(at(40)) == 0);
+    TEST_ASSERT(mm_heapmap_free_bytes(at(4096)) == 4096 - 24);
+
+    mm_heapmap_clear(at(24), 8);
+    TEST_ASSERT(mm_heapmap_allocated(at(16)) == 1);
+    TEST_ASSERT(mm_heapmap_allocated(at(24)) == 0);
+    TEST_ASSERT(mm_heapmap_allocated(at(32)) == 1);
+    TEST_ASSERT(mm_heapmap_free_bytes(at(4096)) == 4096 - 16);
+    TEST_ASSERT(mm_heapmap_free_runs(at(4096)) == 3);
+}
+
+void test_set_across_words(void) {
+    // 64 granules per word: from the middle of the first to the third word
+    mm_heapmap_set(at(8 * 40), 8 * 100);
+    TEST_ASSERT(mm_heapmap_allocated(at(8 * 39)) == 0);
+    TEST_ASSERT(mm_heapmap_allocated(at(8 * 40)) == 1);
+    TEST_ASSERT(mm_heapmap_allocated(at(8 * 139)) == 1);
+    TEST_ASSERT(mm_heapmap_allocated(at(8 * 140)) == 0);
+    TEST_ASSERT(mm_heapmap_free_bytes(at(8 * 200)) == 8 * 100);
+    TEST_ASSERT(mm_heapmap_next_allocated(at(0), at(8 * 200)) == at(8 * 40));
+    TEST_ASSERT(mm_heapmap_next_free(at(8 * 40), at(8 * 200)) == at(8 * 140));
+
+    mm_heapmap_clear(at(8 * 64), 8 * 64);
+    TEST_ASSERT(mm_heapmap_allocated(at(8 * 63)) == 1);
+    TEST_ASSERT(mm_heapmap_allocated(at(8 * 64)) == 0);
+    TEST_ASSERT(mm_heapmap_allocated(at(8 * 127)) == 0);
+    TEST_ASSERT(mm_heapmap_allocated(at(8 * 128)) == 1);
+}
+
+void test_find_first_fit(void) {
+    // allocated everywhere except for two runs: 32 bytes, then 64 bytes
+    mm_heapmap_set(at(0), 32 * 1024);
+    mm_heapmap_clear(at(1000 * 8), 32);
+    mm_heapmap_clear(at(3000 * 8), 64);
+
+    TEST_ASSERT(mm_heapmap_find(at(0), at(32 * 1024), 16) == at(1000 * 8));
+    TEST_ASSERT(mm_heapmap_find(at(0), at(32 * 1024), 32) == at(1000 * 8));
+    TEST_ASSERT(mm_heapmap_find(at(0), at(32 * 1024), 40) == at(3000 * 8));
+    TEST_ASSERT(mm_heapmap_find(at(0), at(32 * 1024), 72) == NULL);
+    TEST_ASSERT(mm_heapmap_find(at(1001 * 8), at(32 * 1024), 8) == at(1001 * 8));
+    TEST_ASSERT(mm_heapmap_find(at(0), at(3000 * 8), 40) == NULL);
+    TEST_ASSERT(mm_heapmap_largest_free(at(32 * 1024)) == 64);
+    TEST_ASSERT(mm_heapmap_free_bytes(at(32 * 1024)) == 96);
+    TEST_ASSERT(mm_heapmap_free_runs(at(32 * 1024)) == 2);
+    TEST_ASSERT(mm_heapmap_free_runs(at(3000 * 8)) == 1);
+}
+
+void test_find_stops_at_end(void) {
+    // free granules after the end are not counted
+    mm_heapmap_set(at(0), 8 * 70);
+    TEST_ASSERT(mm_heapmap_next_free(at(0), at(8 * 70)) == at(8 * 70));
+    TEST_ASSERT(mm_heapmap_find(at(0), at(8 * 72), 24) == NULL);
+    TEST_ASSERT(mm_heapmap_find(at(0), at(8 * 73), 24) == at(8 * 70));
+    TEST_ASSERT(mm_heapmap_largest_free(at(8 * 72)) == 16);
+    TEST_ASSERT(mm_heapmap_free_bytes(at(8 * 70)) == 0);
+    TEST_ASSERT(mm_heapmap_free_runs(at(8 * 70)) == 0);
+    TEST_ASSERT(mm_heapmap_free_runs(at(8 * 72)) == 1);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_empty);
+    RUN_TEST(test_set_clear);
+    RUN_TEST(test_set_across_words);
+    RUN_TEST(test_find_first_fit);
+    RUN_TEST(test_find_stops_at_end);
+    return UNITY_END();
+}
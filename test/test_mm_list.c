@@ -3,19 +3,32 @@
 
 #include "mm.h"
 #include "mm_list.h"
+#include "mm_bitmap.h"
+#include "mm_tree.h"
 
-#include <stdlib.h>
+// size class of the blocks returned by new_block()
+#define CLS mm_list_class(16)
 
 static BlockHeader *new_block() {
-    // NOTE: here we are allocating blocks with malloc, but
-    // mm.c should allocate them on the heap that you're managing
-    BlockHeader *bp = malloc(16);
+    // NOTE: here we are taking blocks directly from the heap, but
+    // mm.c should allocate them as blocks on the heap that you're managing
+    BlockHeader *bp = (BlockHeader *)mem_sbrk(16);
+    mm_block_set_header(bp, 16, 0);
     *(bp+1) = 0x03030303;
     *(bp+2) = 0x04040404;
     return bp;
 }
 
+static BlockHeader *new_block_size(int size) {
+    BlockHeader *bp = (BlockHeader *)mem_sbrk(size);
+    mm_block_set_header(bp, size, 0);
+    return bp;
+}
+
 void setUp(void) {
+    // links are offsets from heap_blocks: blocks must come after it
+    mem_reset_brk();
+    heap_blocks = (BlockHeader *)mem_sbrk(8);
     mm_list_init();
 }
 
@@ -24,25 +37,25 @@ void tearDown(void) {
 }
 
 void test_append_empty(void) {
-    TEST_ASSERT(mm_list_headp == NULL);
-    TEST_ASSERT(mm_list_tailp == NULL);
+    TEST_ASSERT(mm_list_headp[CLS] == NULL);
+    TEST_ASSERT(mm_list_tailp[CLS] == NULL);
     BlockHeader *b1 = new_block();
     mm_list_append(b1);
-    TEST_ASSERT(mm_list_headp == b1);
+    TEST_ASSERT(mm_list_headp[CLS] == b1);
     TEST_ASSERT(mm_list_next(b1) == NULL);
     TEST_ASSERT(mm_list_prev(b1) == NULL);
-    TEST_ASSERT(mm_list_tailp == b1);
+    TEST_ASSERT(mm_list_tailp[CLS] == b1);
 }
 
 void test_prepend_empty(void) {
-    TEST_ASSERT(mm_list_headp == NULL);
-    TEST_ASSERT(mm_list_tailp == NULL);
+    TEST_ASSERT(mm_list_headp[CLS] == NULL);
+    TEST_ASSERT(mm_list_tailp[CLS] == NULL);
     BlockHeader *b1 = new_block();
     mm_list_prepend(b1);
-    TEST_ASSERT(mm_list_headp == b1);
+    TEST_ASSERT(mm_list_headp[CLS] == b1);
     TEST_ASSERT(mm_list_next(b1) == NULL);
     TEST_ASSERT(mm_list_prev(b1) == NULL);
-    TEST_ASSERT(mm_list_tailp == b1);
+    TEST_ASSERT(mm_list_tailp[CLS] == b1);
 }
 
 void test_append_nonempty(void) {
@@ -50,12 +63,12 @@ void test_append_nonempty(void) {
     BlockHeader *b2 = new_block();
     mm_list_append(b1);
     mm_list_append(b2);
-    TEST_ASSERT(mm_list_headp == b1);
+    TEST_ASSERT(mm_list_headp[CLS] == b1);
     TEST_ASSERT(mm_list_prev(b1) == NULL);
     TEST_ASSERT(mm_list_next(b1) == b2);
     TEST_ASSERT(mm_list_prev(b2) == b1);
     TEST_ASSERT(mm_list_next(b2) == NULL);
-    TEST_ASSERT(mm_list_tailp == b2);
+    TEST_ASSERT(mm_list_tailp[CLS] == b2);
 }
 
 void test_prepend_nonempty(void) {
@@ -64,22 +77,24 @@ void test_prepend_nonempty(void) {
     mm_list_prepend(b1);
     mm_list_prepend(b2);
 
-    TEST_ASSERT(mm_list_headp == b2);
+    TEST_ASSERT(mm_list_headp[CLS] == b2);
     TEST_ASSERT(mm_list_prev(b2) == NULL);
     TEST_ASSERT(mm_list_next(b2) == b1);
     TEST_ASSERT(mm_list_prev(b1) == b2);
     TEST_ASSERT(mm_list_next(b1) == NULL);
-    TEST_ASSERT(mm_list_tailp == b1);
+    TEST_ASSERT(mm_list_tailp[CLS] == b1);
 }
 
 void test_remove_single(void) {
     BlockHeader *b1 = new_block();
     mm_list_append(b1);
-    TEST_ASSERT(mm_list_headp == b1);
-    TEST_ASSERT(mm_list_tailp == b1);
+    TEST_ASSERT(mm_list_headp[CLS] == b1);
+    TEST_ASSERT(mm_list_tailp[CLS] == b1);
+    TEST_ASSERT(mm_bitmap_find(0) == CLS);
     mm_list_remove(b1);
-    TEST_ASSERT(mm_list_headp == NULL);
-    TEST_ASSERT(mm_list_tailp == NULL);
+    TEST_ASSERT(mm_list_headp[CLS] == NULL);
+    TEST_ASSERT(mm_list_tailp[CLS] == NULL);
+    TEST_ASSERT(mm_bitmap_find(0) == -1);
 }
 
 void test_remove_head(void) {
@@ -88,10 +103,10 @@ void test_remove_head(void) {
     mm_list_append(b1);
     mm_list_append(b2);
     mm_list_remove(b1);
-    TEST_ASSERT(mm_list_headp == b2);
+    TEST_ASSERT(mm_list_headp[CLS] == b2);
     TEST_ASSERT(mm_list_prev(b2) == NULL);
     TEST_ASSERT(mm_list_next(b2) == NULL);
-    TEST_ASSERT(mm_list_tailp == b2);
+    TEST_ASSERT(mm_list_tailp[CLS] == b2);
 }
 
 void test_remove_tail(void) {
@@ -100,10 +115,10 @@ void test_remove_tail(void) {
     mm_list_append(b1);
     mm_list_append(b2);
     mm_list_remove(b2);
-    TEST_ASSERT(mm_list_headp == b1);
+    TEST_ASSERT(mm_list_headp[CLS] == b1);
     TEST_ASSERT(mm_list_prev(b1) == NULL);
     TEST_ASSERT(mm_list_next(b1) == NULL);
-    TEST_ASSERT(mm_list_tailp == b1);
+    TEST_ASSERT(mm_list_tailp[CLS] == b1);
 }
 
 void test_remove_middle(void) {
@@ -114,16 +129,76 @@ void test_remove_middle(void) {
     mm_list_append(b2);
     mm_list_append(b3);
     mm_list_remove(b2);
-    TEST_ASSERT(mm_list_headp == b1);
+    TEST_ASSERT(mm_list_headp[CLS] == b1);
     TEST_ASSERT(mm_list_prev(b1) == NULL);
     TEST_ASSERT(mm_list_next(b1) == b3);
     TEST_ASSERT(mm_list_prev(b3) == b1);
     TEST_ASSERT(mm_list_next(b3) == NULL);
-    TEST_ASSERT(mm_list_tailp == b3);
+    TEST_ASSERT(mm_list_tailp[CLS] == b3);
+}
+
+void test_class_small(void) {
+    // one class for each size up to 256 bytes
+    TEST_ASSERT(mm_list_class(16) == 2);
+    TEST_ASSERT(mm_list_class(24) == 3);
+    TEST_ASSERT(mm_list_class(120) == 15);
+    TEST_ASSERT(mm_list_class(128) == 16);
+    TEST_ASSERT(mm_list_class(248) == 31);
+    TEST_ASSERT(mm_list_fit_class(16) == mm_list_class(16));
+    TEST_ASSERT(mm_list_fit_class(248) == mm_list_class(248));
+}
+
+void test_class_large(void) {
+    // 16 classes for each power-of-two range
+    TEST_ASSERT(mm_list_class(256) == 32);
+    TEST_ASSERT(mm_list_class(264) == 32);
+    TEST_ASSERT(mm_list_class(272) == 33);
+    TEST_ASSERT(mm_list_class(4096) == mm_list_class(4096 + 248));
+    TEST_ASSERT(mm_list_class(4096 + 256) == mm_list_class(4096) + 1);
+    TEST_ASSERT(mm_list_class(8192) == mm_list_class(4096) + MM_LIST_SL_COUNT);
+    TEST_ASSERT(mm_list_class(0x7ffffff8) < MM_LIST_CLASSES);
+}
+
+void test_fit_class_large(void) {
+    // lower bounds fit in their own class, other sizes in the next one
+    TEST_ASSERT(mm_list_fit_class(256) == mm_list_class(256));
+    TEST_ASSERT(mm_list_fit_class(264) == mm_list_class(264) + 1);
+    TEST_ASSERT(mm_list_fit_class(4096 + 8) == mm_list_class(4096) + 1);
+    TEST_ASSERT(mm_list_fit_class(0x7ffffff8) <= MM_LIST_CLASSES);
+}
+
+void test_separate_classes(void) {
+    BlockHeader *b1 = new_block();
+    BlockHeader *b2 = new_block_size(24);
+    BlockHeader *b3 = new_block_size(512);
+    mm_list_append(b1);
+    mm_list_append(b2);
+    mm_list_append(b3);
+    TEST_ASSERT(mm_list_headp[CLS] == b1);
+    TEST_ASSERT(mm_list_next(b1) == NULL);
+    TEST_ASSERT(mm_list_headp[mm_list_class(24)] == b2);
+    TEST_ASSERT(mm_list_next(b2) == NULL);
+    TEST_ASSERT(mm_list_headp[mm_list_class(512)] == b3);
+    TEST_ASSERT(mm_list_tailp[mm_list_class(512)] == b3);
+    mm_list_remove(b2);
+    TEST_ASSERT(mm_list_headp[mm_list_class(24)] == NULL);
+    TEST_ASSERT(mm_list_headp[CLS] == b1);
+    TEST_ASSERT(mm_list_headp[mm_list_class(512)] == b3);
+}
+
+void test_large_in_tree(void) {
+    BlockHeader *b1 = new_block_size(MM_TREE_MIN_SIZE);
+    mm_list_append(b1);
+    TEST_ASSERT(mm_list_headp[mm_list_class(MM_TREE_MIN_SIZE)] == NULL);
+    TEST_ASSERT(mm_tree_rootp == b1);
+    TEST_ASSERT(mm_bitmap_find(0) == -1);
+    mm_list_remove(b1);
+    TEST_ASSERT(mm_tree_rootp == NULL);
 }
 
 int main(void) {
     UNITY_BEGIN();
+    mem_init();
     RUN_TEST(test_append_empty);
     RUN_TEST(test_append_nonempty);
     RUN_TEST(test_prepend_empty);
@@ -132,5 +207,11 @@ int main(void) {
     RUN_TEST(test_remove_head);
     RUN_TEST(test_remove_tail);
     RUN_TEST(test_remove_middle);
+    RUN_TEST(test_class_small);
+    RUN_TEST(test_class_large);
+    RUN_TEST(test_fit_class_large);
+    RUN_TEST(test_separate_classes);
+    RUN_TEST(test_large_in_tree);
+    mem_deinit();
     return UNITY_END();
 }
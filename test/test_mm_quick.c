@@ -0,0 +1,93 @@
+#include "unity.h"
+#include "memlib.h"
+
+#include "mm.h"
+#include "mm_quick.h"
+
+static char heap[2 * MM_QUICK_MAX];
+
+void setUp(void) {
+    mm_quick_init();
+}
+
+void tearDown(void) {
+
+}
+
+/**
+ * Create an allocated block of `size` bytes at `offset` in the test heap.
+ */
+static BlockHeader *new_block(int offset, int size) {
+    BlockHeader *bp = (BlockHeader *)(heap + offset);
+    mm_block_set_header(bp, size, 1);
+    return bp;
+}
+
+void test_empty(void) {
+    TEST_ASSERT(mm_quick_pop(72) == NULL);
+    TEST_ASSERT(mm_quick_pop_any() == NULL);
+    TEST_ASSERT(mm_quick_bytes() == 0);
+}
+
+void test_exact_size(void) {
+    BlockHeader *bp = new_block(0, 72);
+    TEST_ASSERT(mm_quick_push(bp));
+    TEST_ASSERT(mm_quick_bytes() == 72);
+    TEST_ASSERT(mm_quick_pop(80) == NULL);
+    TEST_ASSERT(mm_quick_pop(64) == NULL);
+    TEST_ASSERT(mm_quick_pop(72) == bp);
+    TEST_ASSERT(mm_quick_pop(72) == NULL);
+    TEST_ASSERT(mm_quick_bytes() == 0);
+}
+
+void test_lifo(void) {
+    BlockHeader *bp1 = new_block(0, 128);
+    BlockHeader *bp2 = new_block(128, 128);
+    BlockHeader *bp3 = new_block(256, 128);
+    mm_quick_push(bp1);
+    mm_quick_push(bp2);
+    mm_quick_push(bp3);
+    TEST_ASSERT(mm_quick_pop(128) == bp3);
+    TEST_ASSERT(mm_quick_pop(128) == bp2);
+    TEST_ASSERT(mm_quick_pop(128) == bp1);
+}
+
+void test_too_large(void) {
+    BlockHeader *bp = new_block(0, MM_QUICK_MAX + 8);
+    TEST_ASSERT(!mm_quick_push(bp));
+    TEST_ASSERT(mm_quick_bytes() == 0);
+    TEST_ASSERT(mm_quick_pop(MM_QUICK_MAX + 8) == NULL);
+
+    bp = new_block(0, MM_QUICK_MAX);
+    TEST_ASSERT(mm_quick_push(bp));
+    TEST_ASSERT(mm_quick_pop(MM_QUICK_MAX) == bp);
+}
+
+void test_pop_any(void) {
+    BlockHeader *bp1 = new_block(0, 1024);
+    BlockHeader *bp2 = new_block(1024, 16);
+    BlockHeader *bp3 = new_block(1040, MM_QUICK_MAX);
+    mm_quick_push(bp1);
+    mm_quick_push(bp2);
+    mm_quick_push(bp3);
+    TEST_ASSERT(mm_quick_bytes() == 1040 + MM_QUICK_MAX);
+
+    int popped = 0;
+    BlockHeader *bp;
+    while ((bp = mm_quick_pop_any()) != NULL) {
+        TEST_ASSERT(bp == bp1 || bp == bp2 || bp == bp3);
+        popped++;
+    }
+    TEST_ASSERT(popped == 3);
+    TEST_ASSERT(mm_quick_bytes() == 0);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_empty);
+    RUN_TEST(test_exact_size);
+    RUN_TEST(test_lifo);
+    RUN_TEST(test_too_large);
+    RUN_TEST(test_pop_any);
+    return UNITY_END();
+}
@@ -0,0 +1,94 @@
+#include "unity.h"
+#include "memlib.h"
+
+#include "mm.h"
+#include "mm_round.h"
+
+void setUp(void) {
+    mm_round_init();
+}
+
+void tearDown(void) {
+
+}
+
+/**
+ * Free blocks of `freed_size`, then miss requests of `requested_size`.
+ */
+static void free_then_miss(int freed_size, int requested_size, int times) {
+    for (int i = 0; i < times; i++) {
+        mm_round_freed(freed_size);
+    }
+    for (int i = 0; i < times; i++) {
+        mm_round_size(requested_size);
+        mm_round_missed(requested_size);
+    }
+}
+
+void test_no_history(void) {
+    TEST_ASSERT(mm_round_size(16) == 16);
+    TEST_ASSERT(mm_round_size(456) == 456);
+    TEST_ASSERT(mm_round_size(MM_ROUND_MAX) == MM_ROUND_MAX);
+}
+
+void test_learn_larger_size(void) {
+    free_then_miss(456, 512, 16);
+    TEST_ASSERT(mm_round_size(456) == 512);
+    TEST_ASSERT(mm_round_size(448) == 448);
+    TEST_ASSERT(mm_round_size(512) == 512);
+}
+
+void test_few_misses(void) {
+    free_then_miss(120, 136, 2);
+    TEST_ASSERT(mm_round_size(120) == 120);
+}
+
+void test_too_much_larger(void) {
+    // rounding 120 up to 160 would waste too much
+    free_then_miss(120, 160, 16);
+    TEST_ASSERT(mm_round_size(120) == 120);
+}
+
+void test_no_frees(void) {
+    for (int i = 0; i < 16; i++) {
+        mm_round_size(136);
+        mm_round_missed(136);
+    }
+    TEST_ASSERT(mm_round_size(120) == 120);
+    TEST_ASSERT(mm_round_size(128) == 128);
+}
+
+void test_old_frees_fade(void) {
+    for (int i = 0; i < 16; i++) {
+        mm_round_freed(120);
+    }
+    // lots of frees of other sizes
+    for (int i = 0; i < 16 * 1024; i++) {
+        mm_round_freed(2048);
+    }
+    free_then_miss(512, 136, 16);
+    TEST_ASSERT(mm_round_size(120) == 120);
+}
+
+void test_old_target_dropped(void) {
+    free_then_miss(456, 512, 16);
+    TEST_ASSERT(mm_round_size(456) == 512);
+
+    // a later phase of the workload, with frees of other sizes only
+    for (int i = 0; i < 16 * 1024; i++) {
+        mm_round_freed(2048);
+    }
+    TEST_ASSERT(mm_round_size(456) == 456);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_no_history);
+    RUN_TEST(test_learn_larger_size);
+    RUN_TEST(test_few_misses);
+    RUN_TEST(test_too_much_larger);
+    RUN_TEST(test_no_frees);
+    RUN_TEST(test_old_frees_fade);
+    RUN_TEST(test_old_target_dropped);
+    return UNITY_END();
+}
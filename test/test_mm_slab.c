@@ -0,0 +1,130 @@
+#include "unity.h"
+#include "memlib.h"
+
+#include "mm.h"
+#include "mm_slab.h"
+
+#include <stdint.h>
+
+static char *new_run() {
+    // NOTE: here we are taking runs directly from the heap, but
+    // mm.c should allocate them as blocks on the heap that you're managing
+    char *p = mem_sbrk(2 * MM_SLAB_RUN_SIZE);
+    return (char *)(((uintptr_t)p + MM_SLAB_RUN_SIZE - 1) & ~(uintptr_t)(MM_SLAB_RUN_SIZE - 1));
+}
+
+void setUp(void) {
+    mem_reset_brk();
+    mm_slab_init();
+}
+
+void tearDown(void) {
+
+}
+
+void test_malloc_no_runs(void) {
+    TEST_ASSERT(mm_slab_malloc(16) == NULL);
+}
+
+void test_malloc_from_run(void) {
+    char *run = new_run();
+    mm_slab_add_run(run, 16);
+    char *p1 = mm_slab_malloc(16);
+    char *p2 = mm_slab_malloc(9);
+    TEST_ASSERT(p1 != NULL);
+    TEST_ASSERT(p2 != NULL);
+    TEST_ASSERT(p1 != p2);
+    TEST_ASSERT(p1 > run && p1 < run + MM_SLAB_RUN_SIZE);
+    TEST_ASSERT(p2 > run && p2 < run + MM_SLAB_RUN_SIZE);
+    TEST_ASSERT((uintptr_t)p1 % MM_ALIGNMENT == 0);
+    TEST_ASSERT(mm_slab_contains(p1));
+    TEST_ASSERT(mm_slab_contains(p2));
+    TEST_ASSERT(mm_slab_size(p1) == 16);
+
+    // other classes have no runs
+#if MM_ALIGNMENT < 16
+    TEST_ASSERT(mm_slab_malloc(8) == NULL);
+#endif
+    TEST_ASSERT(mm_slab_malloc(16 + MM_ALIGNMENT) == NULL);
+}
+
+void test_contains(void) {
+    char *run = new_run();
+    TEST_ASSERT(!mm_slab_contains(run + 8));
+    mm_slab_add_run(run, 64);
+    TEST_ASSERT(mm_slab_contains(run + 8));
+    TEST_ASSERT(!mm_slab_contains(run - 8));
+    TEST_ASSERT(!mm_slab_contains(run + MM_SLAB_RUN_SIZE));
+}
+
+void test_free_reuse(void) {
+    char *run = new_run();
+    mm_slab_add_run(run, 32);
+    char *p1 = mm_slab_malloc(32);
+    char *p2 = mm_slab_malloc(32);
+    TEST_ASSERT(mm_slab_free(p1, 1) == NULL);
+    TEST_ASSERT(mm_slab_malloc(32) == p1);
+
+    // the only run is kept even when empty
+    TEST_ASSERT(mm_slab_free(p1, 1) == NULL);
+    TEST_ASSERT(mm_slab_free(p2, 1) == NULL);
+    TEST_ASSERT(mm_slab_contains(p1));
+
+    // it can be taken later to be released
+    TEST_ASSERT(mm_slab_pop_empty() == run);
+    TEST_ASSERT(mm_slab_pop_empty() == NULL);
+    TEST_ASSERT(!mm_slab_contains(p1));
+
+    // or right away, when asked to
+    run = new_run();
+    mm_slab_add_run(run, 32);
+    p1 = mm_slab_malloc(32);
+    TEST_ASSERT(mm_slab_free(p1, 0) == run);
+    TEST_ASSERT(!mm_slab_contains(p1));
+}
+
+void test_full_run(void) {
+    char *run = new_run();
+    mm_slab_add_run(run, 64);
+    char *first = mm_slab_malloc(64);
+    int count = 1;
+    while (mm_slab_malloc(64) != NULL)
+        count++;
+    TEST_ASSERT(count > MM_SLAB_RUN_SIZE / 64 - 2);
+    TEST_ASSERT(count <= MM_SLAB_RUN_SIZE / 64);
+
+    // freeing an object makes the run available again
+    TEST_ASSERT(mm_slab_free(first, 1) == NULL);
+    TEST_ASSERT(mm_slab_malloc(64) == first);
+    TEST_ASSERT(mm_slab_malloc(64) == NULL);
+}
+
+void test_release_empty_run(void) {
+    char *run1 = new_run();
+    mm_slab_add_run(run1, 8);
+    char *first = mm_slab_malloc(8);
+    while (mm_slab_malloc(8) != NULL)
+        ;
+    char *run2 = new_run();
+    mm_slab_add_run(run2, 8);
+    char *p = mm_slab_malloc(8);
+    TEST_ASSERT(p > run2 && p < run2 + MM_SLAB_RUN_SIZE);
+
+    // run1 now has free objects, so run2 can be released
+    TEST_ASSERT(mm_slab_free(first, 1) == NULL);
+    TEST_ASSERT(mm_slab_free(p, 1) == run2);
+    TEST_ASSERT(!mm_slab_contains(p));
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    mem_init();
+    RUN_TEST(test_malloc_no_runs);
+    RUN_TEST(test_malloc_from_run);
+    RUN_TEST(test_contains);
+    RUN_TEST(test_free_reuse);
+    RUN_TEST(test_full_run);
+    RUN_TEST(test_release_empty_run);
+    mem_deinit();
+    return UNITY_END();
+}
@@ -0,0 +1,158 @@
+#include "unity.h"
+#include "memlib.h"
+
+#include "mm_tcache.h"
+
+#include <pthread.h>
+
+// objects must be on the heap, where their owner is recorded
+static char *objects;
+
+void setUp(void) {
+    mm_tcache_init();
+}
+
+void tearDown(void) {
+
+}
+
+void test_empty(void) {
+    TEST_ASSERT(mm_tcache_pop(16) == NULL);
+    TEST_ASSERT(mm_tcache_pop_any() == NULL);
+    TEST_ASSERT(mm_tcache_pop(MM_TCACHE_MAX + 1) == NULL);
+}
+
+void test_classes(void) {
+    // an object is only handed out for requests that fit in its usable size
+    TEST_ASSERT(mm_tcache_push(objects, 2 * MM_ALIGNMENT + 4));
+    TEST_ASSERT(mm_tcache_pop(2 * MM_ALIGNMENT + 1) == NULL);
+    TEST_ASSERT(mm_tcache_pop(MM_ALIGNMENT) == NULL);
+    TEST_ASSERT(mm_tcache_pop(2 * MM_ALIGNMENT) == objects);
+    TEST_ASSERT(mm_tcache_pop(2 * MM_ALIGNMENT) == NULL);
+
+    TEST_ASSERT(mm_tcache_class_size(1) == MM_ALIGNMENT);
+    TEST_ASSERT(mm_tcache_class_size(MM_ALIGNMENT + 1) == 2 * MM_ALIGNMENT);
+
+    // too large to be cached
+    TEST_ASSERT(!mm_tcache_push(objects, MM_TCACHE_MAX + MM_ALIGNMENT));
+}
+
+void test_lifo_count(void) {
+    for (int i = 0; i < MM_TCACHE_COUNT; i++)
+        TEST_ASSERT(mm_tcache_push(objects + i * 64, 64));
+    TEST_ASSERT(!mm_tcache_push(objects + MM_TCACHE_COUNT * 64, 64));
+
+    TEST_ASSERT(mm_tcache_pop_class(64) == objects + (MM_TCACHE_COUNT - 1) * 64);
+    TEST_ASSERT(mm_tcache_pop(64) == objects + (MM_TCACHE_COUNT - 2) * 64);
+    int count = 2;
+    while (mm_tcache_pop_any() != NULL)
+        count++;
+    TEST_ASSERT(count == MM_TCACHE_COUNT);
+}
+
+void test_budget(void) {
+    // lists of different classes share the budget of the thread
+    size_t total = 0;
+    int pushed = 0;
+    for (size_t size = MM_TCACHE_MAX; size >= MM_ALIGNMENT; size -= MM_ALIGNMENT) {
+        for (int i = 0; i < MM_TCACHE_COUNT; i++) {
+            if (!mm_tcache_push(objects + total, size))
+                break;
+            total += size;
+            pushed++;
+        }
+    }
+    TEST_ASSERT(total <= MM_TCACHE_BUDGET);
+    TEST_ASSERT(total > MM_TCACHE_BUDGET - MM_TCACHE_MAX);
+    while (mm_tcache_pop_any() != NULL)
+        pushed--;
+    TEST_ASSERT(pushed == 0);
+}
+
+void test_batch(void) {
+    // batches double on each miss, for each list
+    TEST_ASSERT(mm_tcache_batch(64) == 1);
+    TEST_ASSERT(mm_tcache_batch(64) == 2);
+    TEST_ASSERT(mm_tcache_batch(128) == 1);
+    int batch = 0;
+    for (int i = 0; i < 10; i++)
+        batch = mm_tcache_batch(64);
+    TEST_ASSERT(batch == MM_TCACHE_BATCH);
+}
+
+static void *free_other_thread(void *arg) {
+    // an object owned by another thread goes to its inbox
+    char *ptr = arg;
+    return (void *)(intptr_t)mm_tcache_remote_free(ptr, 64);
+}
+
+static void *free_large_other_thread(void *arg) {
+    char *ptr = arg;
+    return (void *)(intptr_t)mm_tcache_remote_free(ptr, MM_TCACHE_MAX + MM_ALIGNMENT);
+}
+
+void test_remote_free(void) {
+    char *p1 = objects;
+    char *p2 = objects + 64;
+    mm_tcache_set_owner(p1);
+    mm_tcache_set_owner(p2);
+
+    // the owner frees its objects itself
+    TEST_ASSERT(!mm_tcache_remote_free(p1, 64));
+    TEST_ASSERT(mm_tcache_take_inbox() == NULL);
+
+    pthread_t thread;
+    void *result;
+    pthread_create(&thread, NULL, free_other_thread, p1);
+    pthread_join(thread, &result);
+    TEST_ASSERT(result != NULL);
+    pthread_create(&thread, NULL, free_other_thread, p2);
+    pthread_join(thread, &result);
+    TEST_ASSERT(result != NULL);
+
+    // the owner takes back all of them at once (last freed first)
+    char *inbox = mm_tcache_take_inbox();
+    TEST_ASSERT(inbox == p2);
+    TEST_ASSERT(*(char **)p2 == p1);
+    TEST_ASSERT(*(char **)p1 == NULL);
+    TEST_ASSERT(mm_tcache_take_inbox() == NULL);
+
+    // objects too large to be cached are always freed by the caller
+    pthread_create(&thread, NULL, free_large_other_thread, p1);
+    pthread_join(thread, &result);
+    TEST_ASSERT(result == NULL);
+}
+
+static void *pop_other_thread(void *arg) {
+    (void)arg;
+    return mm_tcache_pop(64);
+}
+
+void test_per_thread(void) {
+    // other threads don't see the objects of this one
+    mm_tcache_push(objects, 64);
+    pthread_t thread;
+    void *result;
+    pthread_create(&thread, NULL, pop_other_thread, NULL);
+    pthread_join(thread, &result);
+    TEST_ASSERT(result == NULL);
+
+    // all caches are emptied when initialized again
+    mm_tcache_init();
+    TEST_ASSERT(mm_tcache_pop(64) == NULL);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    mem_init();
+    objects = mem_sbrk(MM_TCACHE_BUDGET + MM_TCACHE_MAX);
+    RUN_TEST(test_empty);
+    RUN_TEST(test_classes);
+    RUN_TEST(test_lifo_count);
+    RUN_TEST(test_budget);
+    RUN_TEST(test_batch);
+    RUN_TEST(test_remote_free);
+    RUN_TEST(test_per_thread);
+    mem_deinit();
+    return UNITY_END();
+}
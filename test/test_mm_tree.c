@@ -0,0 +1,136 @@
+#include "unity.h"
+#include "memlib.h"
+
+#include "mm.h"
+#include "mm_tree.h"
+
+static BlockHeader *new_block(int size) {
+    // NOTE: here we are taking blocks directly from the heap, but
+    // mm.c should allocate them as blocks on the heap that you're managing
+    BlockHeader *bp = (BlockHeader *)mem_sbrk(size);
+    mm_block_set_header(bp, size, 0);
+    return bp;
+}
+
+/**
+ * Check the red-black properties of a subtree, return its black height.
+ */
+static int check_subtree(BlockHeader *bp, BlockHeader *parent) {
+    if (bp == NULL)
+        return 1;
+
+    TEST_ASSERT(mm_tree_parent(bp) == parent);
+    if (mm_tree_red(bp)) {
+        TEST_ASSERT(!mm_tree_red(mm_tree_left(bp)));
+        TEST_ASSERT(!mm_tree_red(mm_tree_right(bp)));
+    }
+
+    BlockHeader *left = mm_tree_left(bp);
+    BlockHeader *right = mm_tree_right(bp);
+    if (left != NULL) {
+        TEST_ASSERT(mm_block_size(left) < mm_block_size(bp) ||
+                    (mm_block_size(left) == mm_block_size(bp) && left < bp));
+    }
+    if (right != NULL) {
+        TEST_ASSERT(mm_block_size(right) > mm_block_size(bp) ||
+                    (mm_block_size(right) == mm_block_size(bp) && right > bp));
+    }
+
+    int left_height = check_subtree(left, bp);
+    int right_height = check_subtree(right, bp);
+    TEST_ASSERT(left_height == right_height);
+    return left_height + !mm_tree_red(bp);
+}
+
+static void check_tree(void) {
+    TEST_ASSERT(!mm_tree_red(mm_tree_rootp));
+    check_subtree(mm_tree_rootp, NULL);
+}
+
+void setUp(void) {
+    // links are offsets from heap_blocks: blocks must come after it
+    mem_reset_brk();
+    heap_blocks = (BlockHeader *)mem_sbrk(8);
+    mm_tree_init();
+}
+
+void tearDown(void) {
+
+}
+
+void test_insert_empty(void) {
+    BlockHeader *b1 = new_block(1024);
+    mm_tree_insert(b1);
+    TEST_ASSERT(mm_tree_rootp == b1);
+    TEST_ASSERT(mm_tree_left(b1) == NULL);
+    TEST_ASSERT(mm_tree_right(b1) == NULL);
+    TEST_ASSERT(mm_tree_parent(b1) == NULL);
+    check_tree();
+}
+
+void test_remove_single(void) {
+    BlockHeader *b1 = new_block(1024);
+    mm_tree_insert(b1);
+    mm_tree_remove(b1);
+    TEST_ASSERT(mm_tree_rootp == NULL);
+}
+
+void test_best_fit(void) {
+    BlockHeader *b1 = new_block(1024);
+    BlockHeader *b2 = new_block(4096);
+    BlockHeader *b3 = new_block(2048);
+    mm_tree_insert(b1);
+    mm_tree_insert(b2);
+    mm_tree_insert(b3);
+    check_tree();
+    TEST_ASSERT(mm_tree_best_fit(8) == b1);
+    TEST_ASSERT(mm_tree_best_fit(1024) == b1);
+    TEST_ASSERT(mm_tree_best_fit(1032) == b3);
+    TEST_ASSERT(mm_tree_best_fit(2048) == b3);
+    TEST_ASSERT(mm_tree_best_fit(4096) == b2);
+    TEST_ASSERT(mm_tree_best_fit(4104) == NULL);
+}
+
+void test_best_fit_same_size(void) {
+    BlockHeader *b1 = new_block(2048);
+    BlockHeader *b2 = new_block(2048);
+    BlockHeader *low = b1 < b2 ? b1 : b2;
+    mm_tree_insert(b1);
+    mm_tree_insert(b2);
+    check_tree();
+    TEST_ASSERT(mm_tree_best_fit(1024) == low);
+    mm_tree_remove(low);
+    TEST_ASSERT(mm_tree_best_fit(1024) == (low == b1 ? b2 : b1));
+}
+
+void test_insert_remove_many(void) {
+    enum { N = 200 };
+    BlockHeader *blocks[N];
+    for (int i = 0; i < N; i++) {
+        blocks[i] = new_block(1024 + 8 * ((i * 37) % N));
+        mm_tree_insert(blocks[i]);
+        check_tree();
+    }
+    for (int i = 0; i < N; i++) {
+        TEST_ASSERT(mm_block_size(mm_tree_best_fit(1024 + 8 * i)) == (size_t)(1024 + 8 * i));
+    }
+
+    // remove in a different order, checking properties at each step
+    for (int i = 0; i < N; i++) {
+        mm_tree_remove(blocks[(i * 11) % N]);
+        check_tree();
+    }
+    TEST_ASSERT(mm_tree_rootp == NULL);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    mem_init();
+    RUN_TEST(test_insert_empty);
+    RUN_TEST(test_remove_single);
+    RUN_TEST(test_best_fit);
+    RUN_TEST(test_best_fit_same_size);
+    RUN_TEST(test_insert_remove_many);
+    mem_deinit();
+    return UNITY_END();
+}